@@ -0,0 +1,72 @@
+#include "archive_loader.hh"
+
+#include <chrono>
+#include <mutex>
+
+#include "memory_governor.hh"
+
+namespace {
+
+/// @brief Decoder and entry list of an opened archive, held together with their charge against the memory budget.
+struct Loaded {
+  Unlzx archive_;
+  std::map<std::string, LzxEntry> entries_;
+  std::mutex decoder_mutex_;
+  MemoryGovernor::Lease lease_;
+};
+
+struct InFlight {
+  std::mutex mutex_;
+  std::map<std::filesystem::path, ArchiveLoader::Handle> opens_;
+};
+
+/// @brief Returns the registry of opens in flight.
+/// @details Never destroyed, so that unloading the plugin does not block on an open still running.
+InFlight& in_flight() {
+  static auto* registry = new InFlight();
+  return *registry;
+}
+
+std::shared_ptr<const ArchiveLoader::Archive> load(const std::filesystem::path& path) {
+  auto loaded = std::make_shared<Loaded>();
+  if (loaded->archive_.open_archive(path.string().c_str()) != Status::Ok)
+    return nullptr;
+  loaded->entries_ = loaded->archive_.list_archive();
+
+  // The decoder's own footprint is not visible from here; estimate it from the archive's size and its entry list.
+  std::error_code error;
+  auto file_size = std::filesystem::file_size(path, error);
+  loaded->lease_ = MemoryGovernor::Lease(MemoryGovernor::Priority::kArchives,
+                                         (error ? 0 : file_size) + loaded->entries_.size() * ArchiveLoader::kEntryCost);
+
+  // All parts share the ownership of `loaded`, so that the charge is credited once none is in use.
+  return std::make_shared<const ArchiveLoader::Archive>(
+      std::shared_ptr<Unlzx>(loaded, &loaded->archive_),
+      std::shared_ptr<std::map<std::string, LzxEntry>>(loaded, &loaded->entries_),
+      std::shared_ptr<std::mutex>(loaded, &loaded->decoder_mutex_));
+}
+
+}  // namespace
+
+ArchiveLoader::Handle ArchiveLoader::Open(const std::filesystem::path& path) {
+  auto& registry = in_flight();
+  std::lock_guard lock(registry.mutex_);
+
+  // Completed opens are kept while anyone besides the registry holds their result, e.g. a scheduled extraction that
+  // opened the archive ahead of decoding it; otherwise they are dropped on the next request.
+  std::erase_if(registry.opens_, [](const auto& item) {
+    return item.second.wait_for(std::chrono::seconds(0)) == std::future_status::ready &&
+           item.second.get().use_count() <= 1;
+  });
+
+  if (auto iter = registry.opens_.find(path); iter != registry.opens_.end())
+    return iter->second;
+
+  auto handle = std::async(std::launch::async, load, path).share();
+  registry.opens_.emplace(path, handle);
+  return handle;
+}
+
+std::shared_ptr<const ArchiveLoader::Archive> ArchiveLoader::OpenPrivate(const std::filesystem::path& path) {
+  return load(path);
+}
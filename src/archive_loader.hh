@@ -0,0 +1,47 @@
+#pragma once
+
+#include <filesystem>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "unlzx.hh"
+
+/// @brief Opens archives on background threads.
+/// @details Opening reads every entry header, which on slow or remote storage can take long enough to stall the caller.
+/// Opens run on their own threads; callers get a handle to wait on. Requests for an archive whose open is still in
+/// flight join that open instead of starting another, and share its result. So do requests for an archive whose
+/// opened result is still held by a caller. Each opened archive is charged to the `MemoryGovernor` until the last
+/// reference to it goes away.
+class ArchiveLoader {
+ public:
+  /// @brief Estimated memory held per entry: the entry itself, its name and its node in the entry list.
+  static constexpr size_t kEntryCost = 256;
+
+  /// @brief An opened archive with its entry list.
+  /// @details Decoding any entry goes through the archive's one decoder, which is not safe to use from several threads
+  /// at once. Whoever decodes a segment holds `decoder_mutex_` until done with the decoded data.
+  struct Archive {
+    std::shared_ptr<Unlzx> archive_;
+    std::shared_ptr<std::map<std::string, LzxEntry>> entries_;
+    std::shared_ptr<std::mutex> decoder_mutex_;
+  };
+
+  /// @brief Result of an open: the archive, or nullptr if it could not be opened.
+  using Handle = std::shared_future<std::shared_ptr<const Archive>>;
+
+  /// @brief Starts opening an archive, or joins the open already in flight for it.
+  /// @param path Path to the archive file, in normal form.
+  /// @return Handle that becomes ready once the open completes.
+  static Handle Open(const std::filesystem::path& path);
+
+  /// @brief Opens an archive with a decoder of its own, on the calling thread.
+  /// @details The result is never shared, neither with opens in flight nor with other callers, so its decoder can run
+  /// alongside the shared one, e.g. to search several merge groups at once. It is charged to the `MemoryGovernor` like any
+  /// other open.
+  /// @param path Path to the archive file.
+  /// @return The archive, or nullptr if it could not be opened.
+  static std::shared_ptr<const Archive> OpenPrivate(const std::filesystem::path& path);
+};
@@ -0,0 +1,64 @@
+#include "archive_path.hh"
+
+namespace {
+
+bool is_parent_reference(ArchivePath::string_view_type component) {
+  return component.size() == 2 && component[0] == '.' && component[1] == '.';
+}
+
+}  // namespace
+
+void ArchivePath::iterator::Settle() {
+  while (begin_ < path_.size()) {
+    while (begin_ < path_.size() && is_separator(path_[begin_]))
+      ++begin_;
+
+    end_ = begin_;
+    while (end_ < path_.size() && !is_separator(path_[end_]))
+      ++end_;
+
+    // Skip `.` components, they do not change the location.
+    if (end_ - begin_ == 1 && path_[begin_] == '.') {
+      begin_ = end_;
+      continue;
+    }
+    return;
+  }
+  end_ = begin_;
+}
+
+bool ArchivePath::has_parent_references() const {
+  for (auto component : *this) {
+    if (is_parent_reference(component))
+      return true;
+  }
+  return false;
+}
+
+ArchivePath::string_view_type ArchivePath::filename() const {
+  string_view_type last;
+  for (auto component : *this)
+    last = component;
+  return last;
+}
+
+ArchivePath ArchivePath::parent_path() const {
+  size_t last = 0;
+  for (auto iter = begin(); iter != end(); ++iter)
+    last = iter.offset();
+  return ArchivePath(path_.substr(0, last));
+}
+
+std::optional<ArchivePath> ArchivePath::relative_to(const ArchivePath& base) const {
+  auto iter = begin();
+  for (auto component : base) {
+    if (iter == end() || *iter != component || is_parent_reference(component))
+      return {};
+    ++iter;
+  }
+
+  ArchivePath relative(path_.substr(iter.offset()));
+  if (relative.has_parent_references())
+    return {};
+  return relative;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <filesystem>
+#include <iterator>
+#include <optional>
+#include <string_view>
+
+/// @brief Non-owning view over a VFS path, e.g. `C:\dir\archive.lzx\inner\file.txt`.
+/// @details Splits the path into components in place, without allocating. Empty components (repeated or trailing
+/// separators) and `.` components are skipped, so iteration sees the same elements as a sanitized path. Both `/` and
+/// the platform's preferred separator are accepted.
+class ArchivePath {
+ public:
+  using char_type = std::filesystem::path::value_type;
+  using string_view_type = std::basic_string_view<char_type>;
+
+  /// @brief Forward iterator over the path components.
+  class iterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = string_view_type;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const string_view_type*;
+    using reference = string_view_type;
+
+    iterator() = default;
+    iterator(string_view_type path, size_t pos) : path_(path), begin_(pos) { Settle(); }
+
+    string_view_type operator*() const { return path_.substr(begin_, end_ - begin_); }
+
+    iterator& operator++() {
+      begin_ = end_;
+      Settle();
+      return *this;
+    }
+
+    iterator operator++(int) {
+      iterator tmp = *this;
+      ++(*this);
+      return tmp;
+    }
+
+    bool operator==(const iterator& other) const { return begin_ == other.begin_; }
+
+    /// @brief Offset of the current component within the viewed path.
+    size_t offset() const { return begin_; }
+
+   private:
+    /// @brief Advances past separators and `.` components to the start of the next component.
+    void Settle();
+
+    string_view_type path_;
+    size_t begin_{};
+    size_t end_{};
+  };
+
+  explicit ArchivePath(const char_type* path) : path_(path) {}
+  explicit ArchivePath(string_view_type path) : path_(path) {}
+  explicit ArchivePath(const std::filesystem::path& path) : path_(path.native()) {}
+
+  iterator begin() const { return iterator(path_, 0); }
+  iterator end() const { return iterator(path_, path_.size()); }
+
+  /// @brief Returns the viewed string.
+  string_view_type native() const { return path_; }
+
+  /// @brief Returns whether the path has no components.
+  bool empty() const { return begin() == end(); }
+
+  /// @brief Returns whether any component is `..`, i.e. the path is not in normal form.
+  bool has_parent_references() const;
+
+  /// @brief Returns the last component, or an empty view if there is none.
+  string_view_type filename() const;
+
+  /// @brief Returns the path without its last component.
+  ArchivePath parent_path() const;
+
+  /// @brief Returns the remainder of this path if `base` names the same leading components.
+  /// @details Comparison is component-wise and exact. Returns nothing if either path contains `..` components.
+  /// @param base The base path (e.g. the loaded archive file).
+  std::optional<ArchivePath> relative_to(const ArchivePath& base) const;
+
+  /// @brief Returns whether `ch` separates path components.
+  static constexpr bool is_separator(char_type ch) {
+    return ch == '/' || ch == std::filesystem::path::preferred_separator;
+  }
+
+ private:
+  string_view_type path_;
+};
@@ -0,0 +1,60 @@
+#include "archive_root_cache.hh"
+
+ArchiveRootCache& ArchiveRootCache::Instance() {
+  // Never destroyed, like the other process-wide registries.
+  static auto* cache = new ArchiveRootCache();
+  return *cache;
+}
+
+std::optional<std::filesystem::path> ArchiveRootCache::Find(const std::filesystem::path& path) {
+  auto now = Clock::now();
+  std::lock_guard lock(mutex_);
+
+  // Nearest ancestor first; parent_path() stops changing at the root.
+  for (auto ancestor = path;; ancestor = ancestor.parent_path()) {
+    if (auto found = index_.find(ancestor.native()); found != index_.end()) {
+      auto entry = found->second;
+      if (entry->expires_ <= now) {
+        index_.erase(found);
+        entries_.erase(entry);
+      } else if (entry->subtree_ || ancestor == path) {
+        entries_.splice(entries_.begin(), entries_, entry);
+        return entry->root_;
+      }
+    }
+
+    if (!ancestor.has_relative_path())
+      return std::nullopt;
+  }
+}
+
+void ArchiveRootCache::AddArchive(const std::filesystem::path& root) {
+  Add({root, root, /* subtree= */ true, Clock::now() + kArchiveLifetime});
+}
+
+void ArchiveRootCache::AddNone(const std::filesystem::path& path, bool subtree) {
+  Add({path, {}, subtree, Clock::now() + kNoneLifetime});
+}
+
+void ArchiveRootCache::Forget(const std::filesystem::path& path) {
+  std::lock_guard lock(mutex_);
+  if (auto found = index_.find(path.native()); found != index_.end()) {
+    entries_.erase(found->second);
+    index_.erase(found);
+  }
+}
+
+void ArchiveRootCache::Add(Entry entry) {
+  std::lock_guard lock(mutex_);
+  if (auto found = index_.find(entry.path_.native()); found != index_.end()) {
+    entries_.erase(found->second);
+    index_.erase(found);
+  }
+
+  entries_.push_front(std::move(entry));
+  index_.emplace(entries_.front().path_.native(), entries_.begin());
+  if (entries_.size() > kCapacity) {
+    index_.erase(entries_.back().path_.native());
+    entries_.pop_back();
+  }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+
+/// @brief Remembers which paths lie inside an archive, and which lie in none, so that repeated lookups skip the
+/// filesystem.
+/// @details Finding the archive holding a path means checking its ancestors on disk until one exists. Hosts probe many
+/// unrelated paths in bursts (recursive finds, sync compares), each costing several such checks, some on slow network
+/// shares. The cache records, by normal-form path:
+/// - archive roots: every path below one lies inside that archive;
+/// - paths lying in no archive: either a whole subtree (below a missing directory, or a file that is not an archive),
+///   or a single existing directory, which may still hold archives.
+/// Entries are validated by age only, so that a hit costs no filesystem calls: paths found in no archive are trusted
+/// for `kNoneLifetime`, archive roots for `kArchiveLifetime`. At most `kCapacity` entries are kept, dropping the least
+/// recently used.
+class ArchiveRootCache {
+ public:
+  static constexpr size_t kCapacity = 256;
+  static constexpr std::chrono::seconds kArchiveLifetime{30};
+  static constexpr std::chrono::seconds kNoneLifetime{2};
+
+  /// @brief Returns the cache shared by all plugin instances.
+  static ArchiveRootCache& Instance();
+
+  ArchiveRootCache(const ArchiveRootCache&) = delete;
+  ArchiveRootCache& operator=(const ArchiveRootCache&) = delete;
+
+  /// @brief Looks up the archive holding a path.
+  /// @param path Path in normal form.
+  /// @return The archive root; an empty path if the path is known to lie in no archive; nullopt if not cached.
+  std::optional<std::filesystem::path> Find(const std::filesystem::path& path);
+
+  /// @brief Records an archive root.
+  void AddArchive(const std::filesystem::path& root);
+
+  /// @brief Records a path lying in no archive.
+  /// @param subtree true if no path below it lies in an archive either.
+  void AddNone(const std::filesystem::path& path, bool subtree);
+
+  /// @brief Drops what is known about a path, e.g. an archive root that failed to open.
+  void Forget(const std::filesystem::path& path);
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  struct Entry {
+    std::filesystem::path path_;
+    // Archive holding `path_` and everything below it; empty if none.
+    std::filesystem::path root_;
+    bool subtree_;
+    Clock::time_point expires_;
+  };
+
+  ArchiveRootCache() = default;
+
+  void Add(Entry entry);
+
+  std::mutex mutex_;
+  // Most recently used first.
+  std::list<Entry> entries_;
+  std::unordered_map<std::filesystem::path::string_type, std::list<Entry>::iterator> index_;
+};
@@ -0,0 +1,117 @@
+#include "buffer_pool.hh"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <new>
+
+namespace {
+
+using Priority = MemoryGovernor::Priority;
+
+uint8_t* allocate_block(size_t size) {
+  auto* data = static_cast<uint8_t*>(::operator new(size, std::align_val_t{BufferPool::kAlignment}, std::nothrow));
+  if (data)
+    MemoryGovernor::Instance().Charge(Priority::kBuffers, size);
+  return data;
+}
+
+void free_block(uint8_t* data, size_t size) {
+  ::operator delete(data, std::align_val_t{BufferPool::kAlignment});
+  MemoryGovernor::Instance().Credit(Priority::kBuffers, size);
+}
+
+}  // namespace
+
+BufferPool::Buffer& BufferPool::Buffer::operator=(Buffer&& other) noexcept {
+  if (this != &other) {
+    if (data_)
+      Instance().Release(data_, size_, size_class_);
+    data_ = std::exchange(other.data_, nullptr);
+    size_ = std::exchange(other.size_, 0);
+    size_class_ = other.size_class_;
+  }
+  return *this;
+}
+
+BufferPool::Buffer::~Buffer() {
+  if (data_)
+    Instance().Release(data_, size_, size_class_);
+}
+
+BufferPool& BufferPool::Instance() {
+  // Never destroyed: buffers may still be released by threads running while the plugin unloads.
+  static auto* pool = new BufferPool();
+  return *pool;
+}
+
+BufferPool::BufferPool() {
+  for (auto& blocks : free_)
+    blocks.reserve(kMaxFreePerClass);
+  registration_ = MemoryGovernor::Instance().Register(Priority::kBuffers, [this] { Trim(); });
+}
+
+size_t BufferPool::ClassOf(size_t size) {
+  auto bits = std::max<size_t>(std::bit_width(size - 1), kMinClassBits);
+  return bits > kMaxClassBits ? kUnpooled : bits - kMinClassBits;
+}
+
+BufferPool::Buffer BufferPool::Acquire(size_t size) {
+  if (size == 0)
+    return {};
+
+  auto size_class = ClassOf(size);
+  if (size_class != kUnpooled) {
+    std::lock_guard lock(mutex_);
+    if (auto& blocks = free_[size_class]; !blocks.empty()) {
+      auto* data = blocks.back();
+      blocks.pop_back();
+      idle_bytes_ -= ClassSize(size_class);
+      ++reuses_;
+      ++outstanding_;
+      return Buffer(data, size, size_class);
+    }
+  }
+
+  auto* data = allocate_block(size_class == kUnpooled ? size : ClassSize(size_class));
+  if (!data)
+    return {};
+  ++allocations_;
+  ++outstanding_;
+  return Buffer(data, size, size_class);
+}
+
+BufferPool::Buffer BufferPool::Copy(std::span<const uint8_t> data) {
+  auto buffer = Acquire(data.size());
+  if (buffer)
+    std::memcpy(buffer.data(), data.data(), data.size());
+  return buffer;
+}
+
+void BufferPool::Release(uint8_t* data, size_t size, size_t size_class) {
+  --outstanding_;
+  if (size_class != kUnpooled) {
+    std::lock_guard lock(mutex_);
+    if (auto& blocks = free_[size_class]; blocks.size() < kMaxFreePerClass) {
+      blocks.push_back(data);
+      idle_bytes_ += ClassSize(size_class);
+      return;
+    }
+  }
+  free_block(data, size_class == kUnpooled ? size : ClassSize(size_class));
+}
+
+BufferPool::Stats BufferPool::GetStats() const {
+  std::lock_guard lock(mutex_);
+  return {allocations_, reuses_, outstanding_, idle_bytes_};
+}
+
+void BufferPool::Trim() {
+  std::lock_guard lock(mutex_);
+  for (size_t size_class = 0; size_class < kClassCount; ++size_class) {
+    for (auto* data : free_[size_class])
+      free_block(data, ClassSize(size_class));
+    free_[size_class].clear();
+  }
+  idle_bytes_ = 0;
+}
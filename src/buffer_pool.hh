@@ -0,0 +1,115 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "memory_governor.hh"
+
+/// @brief Process-wide pool of aligned buffers for decoded data, reused across segments, entries and archives.
+/// @details Requests are rounded up to a power-of-two size class between `kMinClassBits` and `kMaxClassBits`. Released
+/// blocks are kept on a per-class free list of at most `kMaxFreePerClass` blocks and handed out again; larger requests
+/// and blocks beyond that limit go straight back to the system. The counters tell how many blocks ever came from the
+/// system, so that a steady-state loop can be shown not to allocate. Every block, idle or not, is charged to the
+/// `MemoryGovernor`, which drops the idle ones first when over budget.
+class BufferPool {
+ public:
+  /// @brief Alignment of every block, one cache line.
+  static constexpr size_t kAlignment = 64;
+
+  /// @brief Smallest size class, 4 KiB.
+  static constexpr size_t kMinClassBits = 12;
+
+  /// @brief Largest pooled size class, 64 MiB.
+  static constexpr size_t kMaxClassBits = 26;
+
+  /// @brief Maximum number of idle blocks kept per size class.
+  static constexpr size_t kMaxFreePerClass = 8;
+
+  /// @brief Block taken from the pool, returned to it on destruction. Move-only.
+  class Buffer {
+   public:
+    Buffer() = default;
+    Buffer(Buffer&& other) noexcept { *this = std::move(other); }
+    Buffer& operator=(Buffer&& other) noexcept;
+    ~Buffer();
+
+    /// @brief Returns true if the buffer holds a block.
+    explicit operator bool() const { return data_ != nullptr; }
+
+    uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+    std::span<uint8_t> span() const { return {data_, size_}; }
+
+   private:
+    friend class BufferPool;
+    Buffer(uint8_t* data, size_t size, size_t size_class) : data_(data), size_(size), size_class_(size_class) {}
+
+    uint8_t* data_{};
+    size_t size_{};
+    size_t size_class_{};
+  };
+
+  /// @brief Pool counters, since the process started.
+  struct Stats {
+    // Blocks obtained from the system.
+    uint64_t allocations_;
+    // Requests served from a free list.
+    uint64_t reuses_;
+    // Blocks handed out and not yet returned.
+    uint64_t outstanding_;
+    // Bytes held in free lists.
+    uint64_t idle_bytes_;
+  };
+
+  /// @brief Returns the pool.
+  static BufferPool& Instance();
+
+  BufferPool(const BufferPool&) = delete;
+  BufferPool& operator=(const BufferPool&) = delete;
+
+  /// @brief Takes a block of at least `size` bytes.
+  /// @return The buffer, sized `size`; empty if `size` is 0 or the system is out of memory.
+  Buffer Acquire(size_t size);
+
+  /// @brief Takes a block and copies `data` into it.
+  Buffer Copy(std::span<const uint8_t> data);
+
+  /// @brief Returns a snapshot of the counters.
+  Stats GetStats() const;
+
+  /// @brief Returns all idle blocks to the system.
+  void Trim();
+
+ private:
+  static constexpr size_t kClassCount = kMaxClassBits - kMinClassBits + 1;
+  // Size class of blocks that are not pooled.
+  static constexpr size_t kUnpooled = kClassCount;
+
+  BufferPool();
+
+  /// @brief Takes back a block handed out by `Acquire`.
+  void Release(uint8_t* data, size_t size, size_t size_class);
+
+  /// @brief Returns the size class holding `size` bytes, or `kUnpooled`.
+  static size_t ClassOf(size_t size);
+
+  /// @brief Returns the block size of a pooled size class.
+  static size_t ClassSize(size_t size_class) { return size_t{1} << (size_class + kMinClassBits); }
+
+  mutable std::mutex mutex_;
+  // Idle blocks of each size class. Reserved up front, so that releasing a block never allocates.
+  std::array<std::vector<uint8_t*>, kClassCount> free_;
+
+  MemoryGovernor::Registration registration_;
+
+  std::atomic<uint64_t> allocations_{};
+  std::atomic<uint64_t> reuses_{};
+  std::atomic<uint64_t> outstanding_{};
+  uint64_t idle_bytes_{};
+};
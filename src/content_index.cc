@@ -0,0 +1,249 @@
+#include "content_index.hh"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+namespace {
+
+std::filesystem::path index_path(const std::filesystem::path& root) {
+  return root / ContentIndex::kFileName;
+}
+
+std::FILE* open_file(const std::filesystem::path& path, const char* mode) {
+#ifdef _WIN32
+  wchar_t wide_mode[4]{};
+  std::copy_n(mode, std::min<size_t>(std::strlen(mode), 3), wide_mode);
+  return _wfopen(path.c_str(), wide_mode);
+#else
+  return std::fopen(path.c_str(), mode);
+#endif
+}
+
+/// @brief Replaces `target` with a hard link to `source`. Leaves `target` as it was if the link cannot be made.
+/// @return Whether `target` is now a link to `source`.
+bool replace_with_link(const std::filesystem::path& source, const std::filesystem::path& target) {
+  // Link under a temporary name first, so that the target is never missing.
+  auto temporary = target;
+  temporary += ".opuslzx-link";
+  std::error_code error;
+  std::filesystem::remove(temporary, error);
+  std::filesystem::create_hard_link(source, temporary, error);
+  if (error)
+    return false;
+  std::filesystem::rename(temporary, target, error);
+  if (error)
+    std::filesystem::remove(temporary, error);
+  return !error;
+}
+
+}  // namespace
+
+// --- ContentIndex ---
+
+std::optional<ContentIndex> ContentIndex::Load(std::filesystem::path root) {
+  std::FILE* file = open_file(index_path(root), "r");
+  if (!file)
+    return std::nullopt;
+
+  ContentIndex index(std::move(root));
+  char line[4096 + 32];
+  while (std::fgets(line, sizeof(line), file)) {
+    std::string_view text(line);
+    if (text.ends_with('\n')) {
+      text.remove_suffix(1);
+    } else if (!std::feof(file)) {
+      // Longer than any name the index records; skip the rest of the line.
+      for (int c = 0; c != '\n' && c != EOF;)
+        c = std::fgetc(file);
+      continue;
+    }
+
+    // The name starts after exactly one space and runs to the end of the line; it may itself start with spaces.
+    uint64_t size;
+    uint32_t crc;
+    int name_offset = -1;
+    std::sscanf(line, "%" SCNu64 " %" SCNx32 "%n", &size, &crc, &name_offset);
+    if (name_offset < 0 || static_cast<size_t>(name_offset) + 1 >= text.size() || text[name_offset] != ' ')
+      continue;
+
+    auto name = text.substr(name_offset + 1);
+    std::filesystem::path relative(std::u8string_view(reinterpret_cast<const char8_t*>(name.data()), name.size()));
+    if (index.keys_.emplace(relative, Key(size, crc)).second)
+      index.entries_.emplace(Key(size, crc), std::move(relative));
+  }
+  std::fclose(file);
+  return index;
+}
+
+std::vector<std::filesystem::path> ContentIndex::Find(uint64_t size, uint32_t crc) const {
+  std::vector<std::filesystem::path> result;
+  auto [begin, end] = entries_.equal_range(Key(size, crc));
+  for (auto iter = end; iter != begin;)
+    result.push_back(root_ / (--iter)->second);
+  return result;
+}
+
+void ContentIndex::Add(uint64_t size, uint32_t crc, const std::filesystem::path& path) {
+  auto relative = path.lexically_relative(root_);
+  if (relative.empty() || *relative.begin() == "..")
+    return;
+
+  // Re-extracting over a file replaces its content; drop what was recorded for it before.
+  if (auto previous = keys_.find(relative); previous != keys_.end()) {
+    auto [begin, end] = entries_.equal_range(previous->second);
+    for (auto iter = begin; iter != end; ++iter) {
+      if (iter->second == relative) {
+        entries_.erase(iter);
+        break;
+      }
+    }
+    keys_.erase(previous);
+  }
+
+  keys_.emplace(relative, Key(size, crc));
+  entries_.emplace(Key(size, crc), std::move(relative));
+  modified_ = true;
+}
+
+bool ContentIndex::Save() {
+  if (!modified_)
+    return true;
+
+  std::FILE* file = open_file(index_path(root_), "w");
+  if (!file)
+    return false;
+
+  for (const auto& [key, name] : entries_) {
+    auto utf8 = name.generic_u8string();
+    std::fprintf(file, "%" PRIu64 " %08" PRIx32 " %.*s\n", key.first, key.second, static_cast<int>(utf8.size()),
+                 reinterpret_cast<const char*>(utf8.data()));
+  }
+  bool ok = !std::ferror(file);
+  ok = std::fclose(file) == 0 && ok;
+  modified_ = !ok;
+  return ok;
+}
+
+// --- DedupFileSink ---
+
+DedupFileSink::~DedupFileSink() {
+  CloseCandidate();
+}
+
+bool DedupFileSink::Reuse(const std::filesystem::path& name, uint64_t size, uint32_t crc) {
+  size_ = size;
+  crc_ = crc;
+
+  if (FileSink::Reuse(name, size, crc)) {
+    index_.Add(size, crc, root() / name);
+    return true;
+  }
+  return false;
+}
+
+bool DedupFileSink::Begin(const std::filesystem::path& name, uint64_t size) {
+  CloseCandidate();
+  name_ = name;
+  matched_ = 0;
+
+  // Empty files gain nothing from being linked. Otherwise, take the most recent candidate that still has the right
+  // size; files modified since they were indexed usually do not. The target itself, or a link to it, cannot serve:
+  // writing the target on a mismatch would replace the data being compared with. In sync mode, the candidate must
+  // carry the sync time, as links share it: the target could not be stamped without changing the candidate.
+  if (size != 0) {
+    auto target = root() / name;
+    for (const auto& candidate : index_.Find(size, crc_)) {
+      std::error_code error;
+      if (std::filesystem::file_size(candidate, error) != size || error || !HasSyncTime(candidate))
+        continue;
+      if (std::filesystem::equivalent(candidate, target, error))
+        continue;
+      candidate_ = open_file(candidate, "rb");
+      if (candidate_) {
+        candidate_path_ = candidate;
+        return true;
+      }
+    }
+  }
+  return FileSink::Begin(name, size);
+}
+
+bool DedupFileSink::Write(std::span<const uint8_t> data) {
+  if (candidate_) {
+    if (MatchesCandidate(data)) {
+      matched_ += data.size();
+      return true;
+    }
+    if (!WriteMatchedPart())
+      return false;
+  }
+  return FileSink::Write(data);
+}
+
+bool DedupFileSink::End(bool ok) {
+  if (candidate_) {
+    // The candidate must end where the entry does.
+    if (ok && matched_ == size_ && std::fgetc(candidate_) == EOF) {
+      CloseCandidate();
+      auto target = root() / name_;
+      std::error_code error;
+      std::filesystem::create_directories(target.parent_path(), error);
+      if (replace_with_link(candidate_path_, target)) {
+        index_.Add(size_, crc_, target);
+        return true;
+      }
+      candidate_ = open_file(candidate_path_, "rb");
+    }
+    if (!WriteMatchedPart()) {
+      FileSink::End(false);
+      return false;
+    }
+  }
+
+  bool result = FileSink::End(ok);
+  if (ok && result)
+    index_.Add(size_, crc_, current_path());
+  return result;
+}
+
+bool DedupFileSink::MatchesCandidate(std::span<const uint8_t> data) {
+  buffer_.resize(std::min<size_t>(data.size(), 64 * 1024));
+  while (!data.empty()) {
+    auto chunk = std::min(data.size(), buffer_.size());
+    if (std::fread(buffer_.data(), 1, chunk, candidate_) != chunk ||
+        std::memcmp(buffer_.data(), data.data(), chunk) != 0)
+      return false;
+    data = data.subspan(chunk);
+  }
+  return true;
+}
+
+bool DedupFileSink::WriteMatchedPart() {
+  std::FILE* candidate = std::exchange(candidate_, nullptr);
+  bool result = FileSink::Begin(name_, size_) && (candidate || matched_ == 0);
+  if (result && candidate) {
+    std::rewind(candidate);
+    buffer_.resize(64 * 1024);
+    for (uint64_t remaining = matched_; result && remaining > 0;) {
+      auto chunk = static_cast<size_t>(std::min<uint64_t>(remaining, buffer_.size()));
+      result = std::fread(buffer_.data(), 1, chunk, candidate) == chunk &&
+               FileSink::Write(std::span(buffer_).first(chunk));
+      remaining -= chunk;
+    }
+  }
+  if (candidate)
+    std::fclose(candidate);
+  return result;
+}
+
+void DedupFileSink::CloseCandidate() {
+  if (candidate_)
+    std::fclose(candidate_);
+  candidate_ = nullptr;
+}
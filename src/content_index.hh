@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "extract_sink.hh"
+
+/// @brief On-disk index of the files extracted into a directory tree, by size and CRC-32.
+/// @details Kept in a file named `kFileName` at the root of the tree. Extraction into a tree only deduplicates when
+/// that file exists; creating it (empty) opts the tree in. Each line records size, CRC and, after a single space, the
+/// path of a file relative to the root, in UTF-8 and verbatim to the end of the line.
+class ContentIndex {
+ public:
+  static constexpr const char* kFileName = ".opuslzx-index";
+
+  /// @brief Loads the index of a tree, if the tree has one.
+  /// @param root Root of the tree.
+  /// @return The index, or nullopt if the tree has not opted in.
+  static std::optional<ContentIndex> Load(std::filesystem::path root);
+
+  /// @brief Returns the root of the indexed tree.
+  const std::filesystem::path& root() const { return root_; }
+
+  /// @brief Returns the files recorded with the given size and CRC, as absolute paths, most recent first.
+  std::vector<std::filesystem::path> Find(uint64_t size, uint32_t crc) const;
+
+  /// @brief Records a file.
+  /// @param path Absolute path of the file, below the root.
+  void Add(uint64_t size, uint32_t crc, const std::filesystem::path& path);
+
+  /// @brief Writes the index back, if it changed.
+  /// @return false on write failure.
+  bool Save();
+
+ private:
+  explicit ContentIndex(std::filesystem::path root) : root_(std::move(root)) {}
+
+  std::filesystem::path root_;
+  using Key = std::pair<uint64_t, uint32_t>;
+
+  // Paths relative to the root, keyed by size and CRC, and the reverse mapping.
+  std::multimap<Key, std::filesystem::path> entries_;
+  std::map<std::filesystem::path, Key> keys_;
+  bool modified_{};
+};
+
+/// @brief FileSink that hard-links entries whose content already exists in the tree, instead of keeping another copy.
+/// @details Candidates are the indexed files with the size and CRC recorded in the archive. A CRC-32 cannot confirm a
+/// match, and the archive records nothing stronger, so each entry is decoded and compared byte by byte with the most
+/// recent candidate of the same size. Nothing is written while the data matches. If every byte matches, the target
+/// becomes a hard link to the candidate. On the first mismatch, the part that matched is copied from the candidate and
+/// the rest is written as usual; so is the whole entry if it cannot be linked (e.g. across volumes). Either way, the
+/// file is recorded in the index. Since FileSink replaces targets rather than overwriting them, extracting over a
+/// linked file later leaves the other links untouched. In sync mode, only files carrying the sync time are linked to,
+/// so that linked targets are left alone by the next sync like any other.
+class DedupFileSink : public FileSink {
+ public:
+  /// @param root Directory the entries are written to; below the root of the index.
+  /// @param index Index of the tree. Must outlive the sink.
+  /// @param sync_time Time to stamp files with in sync mode, as for FileSink.
+  DedupFileSink(std::filesystem::path root,
+                ContentIndex& index,
+                std::optional<std::filesystem::file_time_type> sync_time = std::nullopt)
+      : FileSink(std::move(root), sync_time), index_(index) {}
+  ~DedupFileSink() override;
+
+  bool Reuse(const std::filesystem::path& name, uint64_t size, uint32_t crc) override;
+  bool Begin(const std::filesystem::path& name, uint64_t size) override;
+  bool Write(std::span<const uint8_t> data) override;
+  bool End(bool ok) override;
+
+ private:
+  /// @brief Returns whether the candidate continues with `data`.
+  bool MatchesCandidate(std::span<const uint8_t> data);
+
+  /// @brief Starts writing the current entry after all, beginning with the part that matched the candidate.
+  bool WriteMatchedPart();
+
+  void CloseCandidate();
+
+  ContentIndex& index_;
+  std::filesystem::path name_;
+  uint64_t size_{};
+  uint32_t crc_{};
+  // File the current entry is compared with. Open only while all data so far matched it; nothing has been written
+  // for the entry then.
+  std::filesystem::path candidate_path_;
+  std::FILE* candidate_{};
+  // Bytes of the entry that matched the candidate.
+  uint64_t matched_{};
+  std::vector<uint8_t> buffer_;
+};
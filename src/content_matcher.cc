@@ -0,0 +1,56 @@
+#include "content_matcher.hh"
+
+#include <algorithm>
+
+ContentMatcher::ContentMatcher(std::string_view needle)
+    : needle_(needle),
+      searcher_(reinterpret_cast<const uint8_t*>(needle_.data()),
+                reinterpret_cast<const uint8_t*>(needle_.data()) + needle_.size()) {
+  carry_.reserve(2 * needle_.size());
+}
+
+void ContentMatcher::Reset() {
+  carry_.clear();
+  offset_ = 0;
+}
+
+bool ContentMatcher::Scan(std::span<const uint8_t> data, uint64_t offset, const MatchCallback& on_match) const {
+  for (auto it = data.data(), end = data.data() + data.size();;) {
+    auto [first, last] = searcher_(it, end);
+    if (first == end)
+      return true;
+    if (!on_match(offset + (first - data.data())))
+      return false;
+    it = first + 1;
+  }
+}
+
+bool ContentMatcher::Feed(std::span<const uint8_t> data, const MatchCallback& on_match) {
+  const size_t keep = needle_.size() - 1;
+
+  if (!carry_.empty()) {
+    // The carry is shorter than the needle, so every match found here ends within `data`. Appending at most `keep`
+    // bytes also keeps matches that lie entirely within `data` out, so none is reported twice.
+    size_t carry_size = carry_.size();
+    auto head = data.first(std::min(data.size(), keep));
+    carry_.insert(carry_.end(), head.begin(), head.end());
+    bool go_on = Scan(carry_, offset_ - carry_size, on_match);
+    carry_.resize(carry_size);
+    if (!go_on)
+      return false;
+  }
+
+  if (!Scan(data, offset_, on_match))
+    return false;
+
+  // Keep the last `keep` bytes of the stream; a piece shorter than that extends the existing carry.
+  if (data.size() >= keep) {
+    carry_.assign(data.end() - keep, data.end());
+  } else {
+    carry_.insert(carry_.end(), data.begin(), data.end());
+    if (carry_.size() > keep)
+      carry_.erase(carry_.begin(), carry_.end() - keep);
+  }
+  offset_ += data.size();
+  return true;
+}
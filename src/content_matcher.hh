@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// @brief Finds a byte sequence in data that arrives in pieces, such as the decoded segments of an entry.
+/// @details Each piece is scanned with a Boyer-Moore-Horspool searcher. The last `needle - 1` bytes seen are carried
+/// over to the next piece, so that matches spanning any number of pieces are found. Overlapping matches are all
+/// reported.
+class ContentMatcher {
+ public:
+  /// @brief Callback receiving the offset of a match from the start of the stream. Return false to stop.
+  using MatchCallback = std::function<bool(uint64_t offset)>;
+
+  /// @param needle Byte sequence to look for. Must not be empty.
+  explicit ContentMatcher(std::string_view needle);
+
+  // The searcher points into `needle_`.
+  ContentMatcher(const ContentMatcher&) = delete;
+  ContentMatcher& operator=(const ContentMatcher&) = delete;
+
+  /// @brief Starts a new stream.
+  void Reset();
+
+  /// @brief Scans the next piece of the stream.
+  /// @param data The piece; need not be kept after the call.
+  /// @param on_match Callback invoked for every match ending within `data`, in offset order.
+  /// @return false if the callback stopped the search.
+  bool Feed(std::span<const uint8_t> data, const MatchCallback& on_match);
+
+ private:
+  /// @brief Reports every match within `data`, whose first byte lies at `offset` in the stream.
+  bool Scan(std::span<const uint8_t> data, uint64_t offset, const MatchCallback& on_match) const;
+
+  const std::string needle_;
+  const std::boyer_moore_horspool_searcher<const uint8_t*> searcher_;
+  // Tail of the stream so far, shorter than the needle. Holds at most twice that, so one allocation serves all streams.
+  std::vector<uint8_t> carry_;
+  // Offset of the next byte fed.
+  uint64_t offset_{};
+};
@@ -0,0 +1,161 @@
+#include "crc32.hh"
+
+#include <array>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define CRC32_CLMUL 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+// Clang (including clang-cl) and GCC only allow the intrinsics in functions built for the matching target.
+#if defined(__clang__) || defined(__GNUC__)
+#define CRC32_TARGET_CLMUL __attribute__((target("pclmul,sse4.1")))
+#else
+#define CRC32_TARGET_CLMUL
+#endif
+#endif
+
+namespace {
+
+constexpr uint32_t kPolynomial = 0xedb88320;
+
+/// @brief Lookup tables for slicing-by-8: `kTables[n][b]` is the CRC of byte `b` followed by `n` zero bytes.
+constexpr auto kTables = [] {
+  std::array<std::array<uint32_t, 256>, 8> tables{};
+  for (uint32_t byte = 0; byte < 256; ++byte) {
+    uint32_t crc = byte;
+    for (int bit = 0; bit < 8; ++bit)
+      crc = (crc >> 1) ^ (kPolynomial & (0 - (crc & 1)));
+    tables[0][byte] = crc;
+  }
+  for (uint32_t byte = 0; byte < 256; ++byte) {
+    for (size_t slice = 1; slice < tables.size(); ++slice) {
+      uint32_t prev = tables[slice - 1][byte];
+      tables[slice][byte] = (prev >> 8) ^ tables[0][prev & 0xff];
+    }
+  }
+  return tables;
+}();
+
+/// @brief Portable kernel. Operates on the inverted CRC state.
+uint32_t crc32_slice8(uint32_t crc, const uint8_t* data, size_t size) {
+  for (; size >= 8; data += 8, size -= 8) {
+    uint32_t lo;
+    uint32_t hi;
+    std::memcpy(&lo, data, sizeof(lo));
+    std::memcpy(&hi, data + 4, sizeof(hi));
+    lo ^= crc;
+    crc = kTables[7][lo & 0xff] ^ kTables[6][(lo >> 8) & 0xff] ^ kTables[5][(lo >> 16) & 0xff] ^ kTables[4][lo >> 24] ^
+          kTables[3][hi & 0xff] ^ kTables[2][(hi >> 8) & 0xff] ^ kTables[1][(hi >> 16) & 0xff] ^ kTables[0][hi >> 24];
+  }
+  for (; size > 0; ++data, --size)
+    crc = (crc >> 8) ^ kTables[0][(crc ^ *data) & 0xff];
+  return crc;
+}
+
+#ifdef CRC32_CLMUL
+/// @brief Folds the 128-bit accumulator forward by the distance encoded in `keys` and adds in the next block.
+CRC32_TARGET_CLMUL inline __m128i fold(__m128i acc, __m128i keys, __m128i next) {
+  __m128i lo = _mm_clmulepi64_si128(acc, keys, 0x00);
+  __m128i hi = _mm_clmulepi64_si128(acc, keys, 0x11);
+  return _mm_xor_si128(_mm_xor_si128(hi, lo), next);
+}
+
+CRC32_TARGET_CLMUL inline __m128i load(const uint8_t* ptr) {
+  return _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr));
+}
+
+/// @brief Folds 64-byte blocks with carry-less multiplication, then reduces to 32 bits (Intel, "Fast CRC Computation
+/// for Generic Polynomials Using PCLMULQDQ Instruction"). Operates on the inverted CRC state.
+/// @param size Number of bytes; at least 64 and a multiple of 16.
+CRC32_TARGET_CLMUL uint32_t crc32_clmul(uint32_t crc, const uint8_t* data, size_t size) {
+  alignas(16) static constexpr uint64_t k1k2[] = {0x0154442bd4, 0x01c6e41596};
+  alignas(16) static constexpr uint64_t k3k4[] = {0x01751997d0, 0x00ccaa009e};
+  alignas(16) static constexpr uint64_t k5k0[] = {0x0163cd6124, 0x0000000000};
+  alignas(16) static constexpr uint64_t poly[] = {0x01db710641, 0x01f7011641};
+
+  __m128i x1 = _mm_xor_si128(load(data), _mm_cvtsi32_si128(static_cast<int>(crc)));
+  __m128i x2 = load(data + 16);
+  __m128i x3 = load(data + 32);
+  __m128i x4 = load(data + 48);
+  data += 64;
+  size -= 64;
+
+  // Four independent 128-bit lanes, 64 bytes per iteration.
+  __m128i keys = _mm_load_si128(reinterpret_cast<const __m128i*>(k1k2));
+  for (; size >= 64; data += 64, size -= 64) {
+    x1 = fold(x1, keys, load(data));
+    x2 = fold(x2, keys, load(data + 16));
+    x3 = fold(x3, keys, load(data + 32));
+    x4 = fold(x4, keys, load(data + 48));
+  }
+
+  // Fold the lanes into one, then any remaining 16-byte blocks.
+  keys = _mm_load_si128(reinterpret_cast<const __m128i*>(k3k4));
+  x1 = fold(x1, keys, x2);
+  x1 = fold(x1, keys, x3);
+  x1 = fold(x1, keys, x4);
+  for (; size >= 16; data += 16, size -= 16)
+    x1 = fold(x1, keys, load(data));
+
+  // Fold 128 bits to 64.
+  const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+  x2 = _mm_clmulepi64_si128(x1, keys, 0x10);
+  x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+  keys = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(k5k0));
+  x2 = _mm_srli_si128(x1, 4);
+  x1 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask32), keys, 0x00);
+  x1 = _mm_xor_si128(x1, x2);
+
+  // Barrett reduction to 32 bits.
+  keys = _mm_load_si128(reinterpret_cast<const __m128i*>(poly));
+  x2 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask32), keys, 0x10);
+  x2 = _mm_clmulepi64_si128(_mm_and_si128(x2, mask32), keys, 0x00);
+  x1 = _mm_xor_si128(x1, x2);
+  return static_cast<uint32_t>(_mm_extract_epi32(x1, 1));
+}
+
+/// @brief Returns whether the CPU supports PCLMULQDQ and SSE4.1.
+bool has_clmul() {
+  constexpr unsigned kPclmulqdq = 1u << 1;
+  constexpr unsigned kSse41 = 1u << 19;
+#ifdef _MSC_VER
+  int info[4];
+  __cpuid(info, 1);
+  unsigned ecx = static_cast<unsigned>(info[2]);
+#else
+  unsigned eax, ebx, ecx, edx;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+    return false;
+#endif
+  return (ecx & kPclmulqdq) && (ecx & kSse41);
+}
+#endif
+
+}  // namespace
+
+uint32_t crc32_update(uint32_t crc, std::span<const uint8_t> data) {
+  crc = ~crc;
+  const uint8_t* ptr = data.data();
+  size_t size = data.size();
+
+#ifdef CRC32_CLMUL
+  static const bool use_clmul = has_clmul();
+  if (use_clmul && size >= 64) {
+    size_t bulk = size & ~size_t{15};
+    crc = crc32_clmul(crc, ptr, bulk);
+    ptr += bulk;
+    size -= bulk;
+  }
+#endif
+
+  return ~crc32_slice8(crc, ptr, size);
+}
+
+uint32_t crc32_update_portable(uint32_t crc, std::span<const uint8_t> data) {
+  return ~crc32_slice8(~crc, data.data(), data.size());
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+
+/// @brief Updates a CRC-32 (ISO-HDLC, as used by LZX and zlib) with more data.
+/// @details Chains like zlib's `crc32()`: start with 0 and feed the data in any number of pieces. Uses a carry-less
+/// multiply kernel where the CPU supports it (detected once at run time), and slicing-by-8 otherwise.
+/// @param crc CRC of the data processed so far (0 for none).
+/// @param data Next piece of data.
+/// @return CRC of all data processed so far.
+uint32_t crc32_update(uint32_t crc, std::span<const uint8_t> data);
+
+/// @brief Same as crc32_update, but always uses the portable slicing-by-8 kernel. Lets tests check the accelerated
+/// kernel against it on CPUs that have one.
+uint32_t crc32_update_portable(uint32_t crc, std::span<const uint8_t> data);
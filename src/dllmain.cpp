@@ -1,7 +1,9 @@
+#include <iterator>
 #include <strsafe.h>
 
 #include "dopus_wstring_view_span.hh"
 #include "stdafx.h"
+#include "trace.hh"
 
 static constexpr GUID PluginGUID{0x4bcae8da, 0xd598, 0x4a67, {0xa0, 0x45, 0xbb, 0xbb, 0xb8, 0xaf, 0x58, 0xb0}};
 HINSTANCE g_module_instance{};
@@ -27,18 +29,25 @@ __declspec(dllexport) bool VFS_IdentifyW(LPVFSPLUGININFOW lpVFSInfo) {
 }
 
 __declspec(dllexport) bool VFS_ReadDirectoryW(Plugin* plugin, LPVFSFUNCDATA lpVFSData, LPVFSREADDIRDATAW lpRDD) {
-  return plugin->ReadDirectory(lpRDD);
+  TraceScope trace("VFS_ReadDirectoryW", plugin, lpRDD->lpszPath);
+  auto call = plugin->Enter();
+  trace.Size(lpRDD->vfsReadOp);
+  return trace.Result(plugin->ReadDirectory(lpRDD));
 }
 
 __declspec(dllexport) Plugin* WINAPI VFS_Create(LPGUID pGuid) {
-  return new Plugin();
+  TraceScope trace("VFS_Create", nullptr);
+  return trace.Result(new Plugin());
 }
 
 __declspec(dllexport) Plugin* WINAPI VFS_Clone(Plugin* plugin) {
-  return new Plugin(*plugin);
+  TraceScope trace("VFS_Clone", plugin);
+  auto call = plugin->Enter();
+  return trace.Result(new Plugin(*plugin));
 }
 
 __declspec(dllexport) void WINAPI VFS_Destroy(Plugin* plugin) {
+  TraceScope trace("VFS_Destroy", plugin);
   delete plugin;
 }
 
@@ -56,7 +65,10 @@ __declspec(dllexport) PluginFile* WINAPI VFS_CreateFileW(Plugin* plugin,
                                                          DWORD dwFileAttr,
                                                          DWORD dwFlags,
                                                          LPFILETIME lpFT) {
-  return plugin->OpenFile(lpszPath, dwMode == GENERIC_WRITE);
+  TraceScope trace("VFS_CreateFileW", plugin, lpszPath);
+  auto call = plugin->Enter();
+  trace.Size(dwMode);
+  return trace.Result(plugin->OpenFile(ArchivePath(lpszPath), dwMode == GENERIC_WRITE));
 }
 
 __declspec(dllexport) bool WINAPI VFS_ReadFile(Plugin* plugin,
@@ -65,7 +77,14 @@ __declspec(dllexport) bool WINAPI VFS_ReadFile(Plugin* plugin,
                                                LPVOID lpData,
                                                DWORD dwSize,
                                                LPDWORD lpdwReadSize) {
-  return plugin->ReadFile(file, std::span<uint8_t>(static_cast<uint8_t*>(lpData), dwSize), lpdwReadSize);
+  TraceScope trace("VFS_ReadFile", plugin);
+  auto call = plugin->Enter();
+  trace.Handle(file);
+  trace.Size(dwSize);
+  size_t read_size{};
+  bool result = plugin->ReadFile(file, std::span<uint8_t>(static_cast<uint8_t*>(lpData), dwSize), &read_size);
+  *lpdwReadSize = static_cast<DWORD>(read_size);
+  return trace.Result(result);
 }
 
 __declspec(dllexport) BOOL WINAPI VFS_WriteFile(Plugin* data,
@@ -82,7 +101,9 @@ __declspec(dllexport) BOOL WINAPI VFS_GetFileAttrW(Plugin* plugin,
                                                    LPVFSFUNCDATA lpFuncData,
                                                    LPTSTR lpszPath,
                                                    LPDWORD lpdwAttr) {
-  return plugin->GetFileAttr(lpszPath, lpdwAttr);
+  TraceScope trace("VFS_GetFileAttrW", plugin, lpszPath);
+  auto call = plugin->Enter();
+  return trace.Result(plugin->GetFileAttr(ArchivePath(lpszPath), lpdwAttr));
 }
 
 __declspec(dllexport) BOOL WINAPI
@@ -118,11 +139,14 @@ __declspec(dllexport) BOOL WINAPI VFS_GetFileSizeW(Plugin* plugin,
                                                    LPTSTR lpszPath,
                                                    PluginFile* file,
                                                    unsigned __int64* piFileSize) {
+  TraceScope trace("VFS_GetFileSizeW", plugin, lpszPath);
+  auto call = plugin->Enter();
+  trace.Handle(file);
   if (file != nullptr) {
     *piFileSize = file->file_ ? file->file_->unpack_size() : 0;
-    return true;
+    return trace.Result(true);
   }
-  return plugin->GetFileSize(lpszPath, file, piFileSize);
+  return trace.Result(plugin->GetFileSize(ArchivePath(lpszPath), file, piFileSize));
 }
 
 __declspec(dllexport) BOOL WINAPI
@@ -145,6 +169,9 @@ __declspec(dllexport) BOOL WINAPI VFS_SetFileTimeW(Plugin* plugin,
 }
 
 __declspec(dllexport) void WINAPI VFS_CloseFile(Plugin* plugin, LPVFSFUNCDATA lpVFSData, PluginFile* file) {
+  TraceScope trace("VFS_CloseFile", plugin);
+  auto call = plugin->Enter();
+  trace.Handle(file);
   plugin->CloseFile(file);
 }
 
@@ -156,14 +183,19 @@ __declspec(dllexport) BOOL WINAPI VFS_MoveFileW(Plugin* hVFSData,
 }
 
 __declspec(dllexport) int VFS_ContextVerbW(Plugin* plugin, LPVFSFUNCDATA lpVFSData, LPVFSCONTEXTVERBDATAW lpVerbData) {
-  return plugin->ContextVerb(lpVerbData);
+  TraceScope trace("VFS_ContextVerbW", plugin, lpVerbData->lpszPath);
+  auto call = plugin->Enter();
+  return trace.Result(plugin->ContextVerb(lpVerbData));
 }
 
 __declspec(dllexport) UINT WINAPI VFS_BatchOperationW(Plugin* plugin,
                                                       LPVFSFUNCDATA lpVFSData,
                                                       LPWSTR lpszPath,
                                                       LPVFSBATCHDATAW lpBatchData) {
-  return plugin->BatchOperation(lpszPath, lpBatchData);
+  TraceScope trace("VFS_BatchOperationW", plugin, lpszPath);
+  auto call = plugin->Enter();
+  trace.Size(lpBatchData->uiOperation);
+  return trace.Result(plugin->BatchOperation(lpszPath, lpBatchData));
 }
 
 __declspec(dllexport) bool VFS_PropGetW(Plugin* plugin,
@@ -172,7 +204,10 @@ __declspec(dllexport) bool VFS_PropGetW(Plugin* plugin,
                                         LPVOID lpData1,
                                         LPVOID lpData2,
                                         LPVOID lpData3) {
-  return plugin->PropGet(propId, lpPropData, lpData1, lpData2, lpData3);
+  TraceScope trace("VFS_PropGetW", plugin);
+  auto call = plugin->Enter();
+  trace.Size(propId);
+  return trace.Result(plugin->PropGet(propId, lpPropData, lpData1, lpData2, lpData3));
 }
 
 __declspec(dllexport) long VFS_GetLastError(Plugin* data) {
@@ -185,8 +220,10 @@ __declspec(dllexport) bool VFS_GetFreeDiskSpaceW(Plugin* plugin,
                                                  unsigned __int64* piFreeBytesAvailable,
                                                  unsigned __int64* piTotalBytes,
                                                  unsigned __int64* piTotalFreeBytes) {
+  TraceScope trace("VFS_GetFreeDiskSpaceW", plugin, lpszPath);
+  auto call = plugin->Enter();
   if (!plugin->LoadFile(lpszPath))
-    return false;
+    return trace.Result(false);
   if (piFreeBytesAvailable)
     *piFreeBytesAvailable = plugin->GetAvailableSize();
   if (piTotalFreeBytes)
@@ -194,7 +231,7 @@ __declspec(dllexport) bool VFS_GetFreeDiskSpaceW(Plugin* plugin,
   if (piTotalBytes)
     *piTotalBytes = plugin->GetTotalSize();
 
-  return true;
+  return trace.Result(true);
 }
 
 __declspec(dllexport) PluginFindData* WINAPI VFS_FindFirstFileW(Plugin* plugin,
@@ -202,25 +239,37 @@ __declspec(dllexport) PluginFindData* WINAPI VFS_FindFirstFileW(Plugin* plugin,
                                                                 LPWSTR lpszPath,
                                                                 LPWIN32_FIND_DATA lpwfdData,
                                                                 HANDLE hAbortEvent) {
-  return plugin->FindFirst(lpszPath, lpwfdData, hAbortEvent);
+  TraceScope trace("VFS_FindFirstFileW", plugin, lpszPath);
+  auto call = plugin->Enter();
+  return trace.Result(plugin->FindFirst(ArchivePath(lpszPath), lpwfdData, hAbortEvent));
 }
 
 __declspec(dllexport) BOOL WINAPI VFS_FindNextFileW(Plugin* plugin,
                                                     LPVFSFUNCDATA lpVFSData,
                                                     PluginFindData* find_data,
                                                     LPWIN32_FIND_DATA lpwfdData) {
-  return plugin->FindNext(find_data, lpwfdData);
+  TraceScope trace("VFS_FindNextFileW", plugin);
+  auto call = plugin->Enter();
+  trace.Handle(find_data);
+  return trace.Result(plugin->FindNext(find_data, lpwfdData));
 }
 
 __declspec(dllexport) void WINAPI VFS_FindClose(Plugin* plugin, PluginFindData* find_data) {
+  TraceScope trace("VFS_FindClose", plugin);
+  auto call = plugin->Enter();
+  trace.Handle(find_data);
   plugin->FindClose(find_data);
 }
 
 __declspec(dllexport) BOOL WINAPI VFS_ExtractFilesW(Plugin* plugin,
                                                     LPVFSFUNCDATA lpFuncData,
                                                     LPVFSEXTRACTFILESDATAW lpExtractData) {
-  return plugin->ExtractEntries(lpFuncData, dopus::wstring_view_span(lpExtractData->lpszFiles),
-                                lpExtractData->lpszDestPath);
+  dopus::wstring_view_span files(lpExtractData->lpszFiles);
+  // Records the first file's path and the number of files.
+  TraceScope trace("VFS_ExtractFilesW", plugin, lpExtractData->lpszFiles);
+  trace.Size(std::ranges::distance(files));
+  auto call = plugin->Enter();
+  return trace.Result(plugin->ExtractEntries(lpFuncData, files, lpExtractData->lpszDestPath));
 }
 
 __declspec(dllexport) bool VFS_USBSafe(LPOPUSUSBSAFEDATA pUSBSafeData) {
@@ -231,11 +280,15 @@ __declspec(dllexport) bool VFS_Init(LPVFSINITDATA pInitData) {
   return true;
 }
 
-__declspec(dllexport) void VFS_Uninit() {}
+__declspec(dllexport) void VFS_Uninit() {
+  trace_flush();
+}
 
 __declspec(dllexport) LPVFSFILEDATAHEADER WINAPI
 VFS_GetFileInformationW(Plugin* plugin, LPVFSFUNCDATA lpVFSData, LPWSTR lpszPath, HANDLE hHeap, DWORD dwFlags) {
-  return plugin->GetfileInformation(lpszPath, hHeap);
+  TraceScope trace("VFS_GetFileInformationW", plugin, lpszPath);
+  auto call = plugin->Enter();
+  return trace.Result(plugin->GetfileInformation(ArchivePath(lpszPath), hHeap));
 }
 
 }  // extern "C"
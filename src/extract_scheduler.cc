@@ -0,0 +1,220 @@
+#include "extract_scheduler.hh"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#include <algorithm>
+#include <optional>
+#include <span>
+#include <string>
+#include <system_error>
+
+#include "archive_loader.hh"
+#include "extract_sink.hh"
+#include "plugin_core.hh"
+#include "text_utils.hh"
+
+struct ExtractScheduler::Job {
+  std::filesystem::path archive_;
+  std::filesystem::path destination_;
+  bool sync_{};
+  // Keeps the opened archive alive between the open and the extraction, so that the plugin picks it up.
+  std::shared_ptr<const ArchiveLoader::Archive> opened_;
+  std::promise<Result> result_;
+};
+
+namespace {
+
+/// @brief FileSink holding a write slot of the destination volume while it writes or flushes data.
+class ThrottledFileSink : public FileSink {
+ public:
+  ThrottledFileSink(std::filesystem::path root,
+                    std::optional<std::filesystem::file_time_type> sync_time,
+                    ExtractScheduler& scheduler)
+      : FileSink(root, sync_time), scheduler_(scheduler), volume_(ExtractScheduler::VolumeOf(root)) {}
+
+  // Decoding runs between writes, outside the slot.
+  bool Write(std::span<const uint8_t> data) override {
+    WriterSlot slot(*this);
+    return FileSink::Write(data);
+  }
+
+  bool End(bool ok) override {
+    WriterSlot slot(*this);
+    return FileSink::End(ok);
+  }
+
+ private:
+  /// @brief Holds the sink's write slot for its lifetime.
+  class WriterSlot {
+   public:
+    explicit WriterSlot(ThrottledFileSink& sink) : sink_(sink) { sink_.scheduler_.AcquireWriter(sink_.volume_); }
+    ~WriterSlot() { sink_.scheduler_.ReleaseWriter(sink_.volume_); }
+
+    WriterSlot(const WriterSlot&) = delete;
+    WriterSlot& operator=(const WriterSlot&) = delete;
+
+   private:
+    ThrottledFileSink& sink_;
+  };
+
+  ExtractScheduler& scheduler_;
+  ExtractScheduler::Volume volume_;
+};
+
+}  // namespace
+
+ExtractScheduler& ExtractScheduler::Instance() {
+  // Never destroyed: unloading the plugin must not wait for queued extractions under the loader lock.
+  static auto* scheduler = new ExtractScheduler();
+  return *scheduler;
+}
+
+ExtractScheduler::ExtractScheduler() {
+  size_t worker_count = std::max(1u, std::thread::hardware_concurrency());
+  for (size_t worker = 0; worker < worker_count; ++worker)
+    workers_.push_back(std::make_unique<Worker>());
+
+  for (size_t worker = 0; worker < worker_count; ++worker)
+    threads_.emplace_back([this, worker](std::stop_token stop) { RunWorker(worker, std::move(stop)); });
+  for (size_t opener = 0; opener < kOpeners; ++opener)
+    threads_.emplace_back([this](std::stop_token stop) { RunOpener(std::move(stop)); });
+}
+
+std::shared_future<ExtractScheduler::Result> ExtractScheduler::Submit(std::filesystem::path archive,
+                                                                      std::filesystem::path destination,
+                                                                      bool sync) {
+  auto job = std::make_shared<Job>();
+  // Same normal form as the plugin uses, so that its open joins the one made here.
+  job->archive_ = sanitize(std::move(archive));
+  job->destination_ = std::move(destination);
+  job->sync_ = sync;
+  auto result = job->result_.get_future().share();
+
+  std::lock_guard lock(open_mutex_);
+  opens_.push_back(std::move(job));
+  open_changed_.notify_one();
+  return result;
+}
+
+ExtractScheduler::Volume ExtractScheduler::VolumeOf(const std::filesystem::path& path) {
+  std::error_code error;
+  auto absolute = std::filesystem::absolute(path, error);
+  if (error)
+    absolute = path;
+
+#ifdef _WIN32
+  // Mount point, e.g. C:\ or \\server\share\; also resolves volumes mounted in folders.
+  wchar_t mount_point[MAX_PATH];
+  if (GetVolumePathNameW(absolute.c_str(), mount_point, MAX_PATH))
+    return mount_point;
+  return absolute.root_path().native();
+#else
+  // Device of the nearest existing ancestor; the destination is usually created by the extraction itself.
+  for (auto ancestor = absolute;; ancestor = ancestor.parent_path()) {
+    struct stat status;
+    if (::stat(ancestor.c_str(), &status) == 0)
+      return "dev:" + std::to_string(status.st_dev);
+    if (!ancestor.has_relative_path())
+      return ancestor.native();
+  }
+#endif
+}
+
+void ExtractScheduler::AcquireWriter(const Volume& volume) {
+  std::unique_lock lock(volume_mutex_);
+  volume_changed_.wait(lock, [this, &volume] { return writers_[volume] < kWritersPerVolume; });
+  ++writers_[volume];
+}
+
+void ExtractScheduler::ReleaseWriter(const Volume& volume) {
+  std::lock_guard lock(volume_mutex_);
+  --writers_[volume];
+  volume_changed_.notify_all();
+}
+
+void ExtractScheduler::Post(Task task) {
+  std::lock_guard lock(pool_mutex_);
+  auto& worker = *workers_[next_worker_++ % workers_.size()];
+  {
+    std::lock_guard worker_lock(worker.mutex_);
+    worker.tasks_.push_back(std::move(task));
+  }
+  ++pending_;
+  pool_changed_.notify_one();
+}
+
+bool ExtractScheduler::TakeTask(size_t worker, Task& task) {
+  // Own queue first, newest task first; then the oldest task of every other worker, starting with the next one.
+  for (size_t offset = 0; offset < workers_.size(); ++offset) {
+    auto& victim = *workers_[(worker + offset) % workers_.size()];
+    std::lock_guard lock(victim.mutex_);
+    if (victim.tasks_.empty())
+      continue;
+
+    if (offset == 0) {
+      task = std::move(victim.tasks_.back());
+      victim.tasks_.pop_back();
+    } else {
+      task = std::move(victim.tasks_.front());
+      victim.tasks_.pop_front();
+    }
+    return true;
+  }
+  return false;
+}
+
+void ExtractScheduler::RunWorker(size_t worker, std::stop_token stop) {
+  while (true) {
+    {
+      std::unique_lock lock(pool_mutex_);
+      if (!pool_changed_.wait(lock, stop, [this] { return pending_ > 0; }))
+        return;
+      // Claim a task before taking it, so that idle workers only wake for tasks nobody has claimed.
+      --pending_;
+    }
+
+    Task task;
+    while (!TakeTask(worker, task))
+      std::this_thread::yield();
+    task();
+  }
+}
+
+void ExtractScheduler::RunOpener(std::stop_token stop) {
+  while (true) {
+    std::shared_ptr<Job> job;
+    {
+      std::unique_lock lock(open_mutex_);
+      if (!open_changed_.wait(lock, stop, [this] { return !opens_.empty(); }))
+        return;
+      job = std::move(opens_.front());
+      opens_.pop_front();
+    }
+
+    job->opened_ = ArchiveLoader::Open(job->archive_).get();
+    if (!job->opened_) {
+      job->result_.set_value({false, std::chrono::steady_clock::now()});
+      continue;
+    }
+    Post([job] { Extract(*job); });
+  }
+}
+
+void ExtractScheduler::Extract(Job& job) {
+  PluginCore plugin;
+  auto call = plugin.Enter();
+  std::optional<std::filesystem::file_time_type> sync_time;
+  if (job.sync_) {
+    std::error_code error;
+    if (auto time = std::filesystem::last_write_time(job.archive_, error); !error)
+      sync_time = time;
+  }
+  ThrottledFileSink sink(job.destination_ / job.archive_.stem(), sync_time, Instance());
+  bool result = plugin.ExtractTo(job.archive_, sink);
+  job.opened_.reset();
+  job.result_.set_value({result, std::chrono::steady_clock::now()});
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// @brief Process-wide scheduler extracting many archives at once.
+/// @details Extraction of an archive runs in two stages. Opening it (reading all entry headers) is I/O-bound and runs
+/// on up to `kOpeners` opener threads. Decoding and writing its entries is CPU-bound and runs as a single task on a
+/// work-stealing pool with one worker per hardware thread; an archive's entries are decoded in order, since entries of
+/// a merge group share one compressed stream. Across all tasks, at most `kWritersPerVolume` tasks write to the same
+/// destination volume at any time. A task holds its write slot only while it writes or flushes data, not while it
+/// decodes, so the limit throttles the disk without capping the decoding parallelism.
+class ExtractScheduler {
+ public:
+  /// @brief Maximum number of archives being opened at once.
+  static constexpr size_t kOpeners = 4;
+
+  /// @brief Maximum number of tasks writing to one volume at once.
+  static constexpr size_t kWritersPerVolume = 2;
+
+  /// @brief Outcome of an extraction.
+  struct Result {
+    // true if every entry was extracted.
+    bool ok_;
+    // When the last entry was written, or the extraction failed.
+    std::chrono::steady_clock::time_point finished_;
+  };
+
+  /// @brief Identifies a volume: its device number on POSIX, its mount point on Windows.
+  using Volume = std::filesystem::path::string_type;
+
+  /// @brief Returns the scheduler, starting its threads on first use.
+  static ExtractScheduler& Instance();
+
+  ExtractScheduler(const ExtractScheduler&) = delete;
+  ExtractScheduler& operator=(const ExtractScheduler&) = delete;
+
+  /// @brief Queues extraction of a whole archive.
+  /// @details Entries are written below `destination`, in a directory named after the archive without its extension.
+  /// @param archive Path to the archive file.
+  /// @param destination Directory to extract into.
+  /// @param sync true to extract in sync mode (see FileSink), stamping files with the archive's modification time and
+  /// leaving targets written by an earlier sync alone if they still look unchanged.
+  /// @return Future becoming ready once the extraction completes.
+  std::shared_future<Result> Submit(std::filesystem::path archive,
+                                    std::filesystem::path destination,
+                                    bool sync = false);
+
+  /// @brief Returns the volume holding a path. The path need not exist yet.
+  static Volume VolumeOf(const std::filesystem::path& path);
+
+  /// @brief Blocks until a write slot on a volume is free, then takes it.
+  void AcquireWriter(const Volume& volume);
+
+  /// @brief Returns a write slot taken with `AcquireWriter`.
+  void ReleaseWriter(const Volume& volume);
+
+ private:
+  using Task = std::function<void()>;
+  struct Job;
+
+  /// @brief Task queue of one worker. The owner takes from the back, thieves from the front.
+  struct Worker {
+    std::mutex mutex_;
+    std::deque<Task> tasks_;
+  };
+
+  ExtractScheduler();
+
+  /// @brief Queues a task on the pool.
+  void Post(Task task);
+
+  /// @brief Takes a task from the worker's own queue, or steals one from another worker.
+  bool TakeTask(size_t worker, Task& task);
+
+  void RunWorker(size_t worker, std::stop_token stop);
+  void RunOpener(std::stop_token stop);
+
+  /// @brief Decodes and writes the entries of an opened archive.
+  static void Extract(Job& job);
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  size_t next_worker_{};
+  // Guards `pending_`, `next_worker_` and the wakeups of idle workers.
+  std::mutex pool_mutex_;
+  std::condition_variable_any pool_changed_;
+  size_t pending_{};
+
+  std::mutex open_mutex_;
+  std::condition_variable_any open_changed_;
+  std::deque<std::shared_ptr<Job>> opens_;
+
+  std::mutex volume_mutex_;
+  std::condition_variable volume_changed_;
+  std::map<Volume, size_t> writers_;
+
+  // Declared last so that they are joined before the state above is destroyed.
+  std::vector<std::jthread> threads_;
+};
@@ -0,0 +1,328 @@
+#include "extract_sink.hh"
+
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#include <winioctl.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define EXTRACT_SINK_SSE2 1
+#endif
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "crc32.hh"
+
+// --- FileSink ---
+
+namespace {
+
+/// @brief Returns whether every byte of `data` is zero.
+bool is_all_zero(std::span<const uint8_t> data) {
+  size_t pos = 0;
+#ifdef EXTRACT_SINK_SSE2
+  // OR 64 bytes at a time into one register; test it once per iteration.
+  for (; pos + 64 <= data.size(); pos += 64) {
+    auto* ptr = reinterpret_cast<const __m128i*>(data.data() + pos);
+    __m128i acc = _mm_or_si128(_mm_or_si128(_mm_loadu_si128(ptr), _mm_loadu_si128(ptr + 1)),
+                               _mm_or_si128(_mm_loadu_si128(ptr + 2), _mm_loadu_si128(ptr + 3)));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(acc, _mm_setzero_si128())) != 0xffff)
+      return false;
+  }
+#endif
+  return std::all_of(data.begin() + pos, data.end(), [](uint8_t byte) { return byte == 0; });
+}
+
+bool seek_forward(std::FILE* file, uint64_t distance) {
+#ifdef _WIN32
+  return _fseeki64(file, static_cast<int64_t>(distance), SEEK_CUR) == 0;
+#else
+  return fseeko(file, static_cast<off_t>(distance), SEEK_CUR) == 0;
+#endif
+}
+
+/// @brief Marks a file sparse, so that regions seeked over are not allocated. Other platforms create holes implicitly.
+bool mark_sparse(std::FILE* file) {
+#ifdef _WIN32
+  DWORD returned{};
+  auto handle = reinterpret_cast<HANDLE>(_get_osfhandle(_fileno(file)));
+  return DeviceIoControl(handle, FSCTL_SET_SPARSE, nullptr, 0, nullptr, 0, &returned, nullptr);
+#else
+  return true;
+#endif
+}
+
+/// @brief Returns the time a file in `directory` is given when stamped with `time`. Filesystems with coarser timestamps
+/// (FAT, exFAT, some network shares) round it. Found by stamping a temporary file.
+std::optional<std::filesystem::file_time_type> stored_time(const std::filesystem::path& directory,
+                                                           std::filesystem::file_time_type time) {
+  auto probe = directory / ".opuslzx-time";
+#ifdef _WIN32
+  std::FILE* file = _wfopen(probe.c_str(), L"wb");
+#else
+  std::FILE* file = std::fopen(probe.c_str(), "wb");
+#endif
+  if (!file)
+    return std::nullopt;
+  std::fclose(file);
+
+  std::optional<std::filesystem::file_time_type> result;
+  std::error_code error;
+  std::filesystem::last_write_time(probe, time, error);
+  if (!error) {
+    auto stored = std::filesystem::last_write_time(probe, error);
+    if (!error)
+      result = stored;
+  }
+  std::filesystem::remove(probe, error);
+  return result;
+}
+
+}  // namespace
+
+bool file_has_content(const std::filesystem::path& path, uint64_t size, uint32_t crc) {
+  std::error_code error;
+  if (std::filesystem::file_size(path, error) != size || error)
+    return false;
+
+#ifdef _WIN32
+  std::FILE* file = _wfopen(path.c_str(), L"rb");
+#else
+  std::FILE* file = std::fopen(path.c_str(), "rb");
+#endif
+  if (!file)
+    return false;
+
+  std::vector<uint8_t> buffer(64 * 1024);
+  uint32_t file_crc{};
+  while (auto count = std::fread(buffer.data(), 1, buffer.size(), file))
+    file_crc = crc32_update(file_crc, std::span(buffer).first(count));
+  bool ok = !std::ferror(file) && file_crc == crc;
+  std::fclose(file);
+  return ok;
+}
+
+FileSink::~FileSink() {
+  if (file_)
+    std::fclose(file_);
+}
+
+bool FileSink::Reuse(const std::filesystem::path& name, uint64_t size, uint32_t crc) {
+  if (!sync_time_)
+    return false;
+
+  auto path = root_ / name;
+  return HasSyncTime(path) && file_has_content(path, size, crc);
+}
+
+bool FileSink::HasSyncTime(const std::filesystem::path& path) {
+  if (!sync_time_)
+    return true;
+
+  std::error_code error;
+  auto time = std::filesystem::last_write_time(path, error);
+  if (error)
+    return false;
+  if (time == *sync_time_)
+    return true;
+
+  // Otherwise the destination may have rounded the time when the file was stamped. Only then is it worth finding out
+  // how, once per sink.
+  if (!stored_sync_time_)
+    stored_sync_time_ = stored_time(path.parent_path(), *sync_time_).value_or(*sync_time_);
+  return time == *stored_sync_time_;
+}
+
+bool FileSink::Begin(const std::filesystem::path& name, uint64_t size) {
+  current_path_ = root_ / name;
+  offset_ = 0;
+  pending_zeros_ = 0;
+  sparse_.reset();
+
+  std::error_code error;
+  std::filesystem::create_directories(current_path_.parent_path(), error);
+  // Replace the target rather than truncate it: it may be a hard link (see DedupFileSink), and truncating would change
+  // every linked copy.
+  std::filesystem::remove(current_path_, error);
+#ifdef _WIN32
+  file_ = _wfopen(current_path_.c_str(), L"wb");
+#else
+  file_ = std::fopen(current_path_.c_str(), "wb");
+#endif
+  return file_ != nullptr;
+}
+
+bool FileSink::Write(std::span<const uint8_t> data) {
+  while (!data.empty()) {
+    auto block = data.first(std::min<uint64_t>(data.size(), kHoleBlock - offset_ % kHoleBlock));
+    if (block.size() == kHoleBlock && is_all_zero(block) && CanSkipZeros()) {
+      pending_zeros_ += block.size();
+    } else {
+      if (pending_zeros_ && !seek_forward(file_, pending_zeros_))
+        return false;
+      pending_zeros_ = 0;
+      if (std::fwrite(block.data(), 1, block.size(), file_) != block.size())
+        return false;
+    }
+    offset_ += block.size();
+    data = data.subspan(block.size());
+  }
+  return true;
+}
+
+bool FileSink::End(bool ok) {
+  if (!file_)
+    return false;
+
+  bool result = true;
+  // A trailing hole only extends the file once something is written past it.
+  if (pending_zeros_) {
+    static constexpr uint8_t kZero{};
+    result = seek_forward(file_, pending_zeros_ - 1) && std::fwrite(&kZero, 1, 1, file_) == 1;
+    pending_zeros_ = 0;
+  }
+  result = std::fclose(file_) == 0 && result;
+  file_ = nullptr;
+
+  // Only complete files are stamped; a failed stamp merely means the file is written again on the next sync.
+  if (result && ok && sync_time_) {
+    std::error_code error;
+    std::filesystem::last_write_time(current_path_, *sync_time_, error);
+  }
+  return result;
+}
+
+bool FileSink::CanSkipZeros() {
+  if (!sparse_)
+    sparse_ = mark_sparse(file_);
+  return *sparse_;
+}
+
+// --- StreamSink ---
+
+bool StreamSink::Write(std::span<const uint8_t> data) {
+  stream_.write(reinterpret_cast<const char*>(data.data()), data.size());
+  return stream_.good();
+}
+
+bool StreamSink::Finish() {
+  stream_.flush();
+  return stream_.good();
+}
+
+// --- TarSink ---
+
+namespace {
+
+constexpr size_t kTarBlock = 512;
+
+/// @brief ustar header block.
+struct TarHeader {
+  char name[100];
+  char mode[8];
+  char uid[8];
+  char gid[8];
+  char size[12];
+  char mtime[12];
+  char checksum[8];
+  char typeflag;
+  char linkname[100];
+  char magic[6];
+  char version[2];
+  char uname[32];
+  char gname[32];
+  char devmajor[8];
+  char devminor[8];
+  char prefix[155];
+  char padding[12];
+};
+static_assert(sizeof(TarHeader) == kTarBlock);
+
+/// @brief Writes `value` as a NUL-terminated, zero-padded octal number filling `field`.
+template <size_t N>
+bool put_octal(char (&field)[N], uint64_t value) {
+  return std::snprintf(field, N, "%0*llo", static_cast<int>(N - 1), static_cast<unsigned long long>(value)) ==
+         static_cast<int>(N - 1);
+}
+
+}  // namespace
+
+bool TarSink::Begin(const std::filesystem::path& name, uint64_t size) {
+  TarHeader header{};
+
+  // Names longer than the name field are split at a separator into prefix and name.
+  auto utf8_name = name.generic_u8string();
+  std::string_view full(reinterpret_cast<const char*>(utf8_name.data()), utf8_name.size());
+  std::string_view prefix;
+  if (full.size() > sizeof(header.name)) {
+    auto split = full.rfind('/', sizeof(header.prefix));
+    if (split == std::string_view::npos || full.size() - split - 1 > sizeof(header.name))
+      return false;
+    prefix = full.substr(0, split);
+    full = full.substr(split + 1);
+  }
+  std::ranges::copy(full, header.name);
+  std::ranges::copy(prefix, header.prefix);
+
+  put_octal(header.mode, 0644);
+  put_octal(header.uid, 0);
+  put_octal(header.gid, 0);
+  if (!put_octal(header.size, size))
+    return false;
+  put_octal(header.mtime, 0);
+  header.typeflag = '0';
+  std::memcpy(header.magic, "ustar", 6);
+  std::memcpy(header.version, "00", 2);
+
+  // Checksum is computed with the checksum field itself filled with spaces.
+  std::memset(header.checksum, ' ', sizeof(header.checksum));
+  uint32_t checksum = 0;
+  for (auto byte : std::span(reinterpret_cast<const uint8_t*>(&header), sizeof(header)))
+    checksum += byte;
+  std::snprintf(header.checksum, sizeof(header.checksum), "%06o", checksum);
+  header.checksum[7] = ' ';
+
+  size_ = size;
+  written_ = 0;
+  stream_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  return stream_.good();
+}
+
+bool TarSink::Write(std::span<const uint8_t> data) {
+  // Never write past the size announced in the header; that would corrupt the stream.
+  auto count = std::min<uint64_t>(data.size(), size_ - written_);
+  stream_.write(reinterpret_cast<const char*>(data.data()), count);
+  written_ += count;
+  return stream_.good();
+}
+
+bool TarSink::End(bool ok) {
+  // Pad short entries to the announced size, then the entry to the block size.
+  auto padded = (size_ + kTarBlock - 1) / kTarBlock * kTarBlock;
+  return WriteZeros(padded - written_);
+}
+
+bool TarSink::Finish() {
+  // End of archive: two zero blocks.
+  bool result = WriteZeros(2 * kTarBlock);
+  stream_.flush();
+  return result && stream_.good();
+}
+
+bool TarSink::WriteZeros(uint64_t count) {
+  static constexpr std::array<char, kTarBlock> kZeros{};
+  while (count > 0) {
+    auto chunk = std::min<uint64_t>(count, kZeros.size());
+    stream_.write(kZeros.data(), chunk);
+    count -= chunk;
+  }
+  return stream_.good();
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <optional>
+#include <ostream>
+#include <span>
+
+/// @brief Destination of decoded entry data during extraction.
+/// @details Extraction calls `Begin`, any number of `Write`s and `End` for every entry, in order, and `Finish` once all
+/// entries are done. Names are relative to the extraction root and use the archive's directory structure.
+class ExtractSink {
+ public:
+  virtual ~ExtractSink() = default;
+
+  /// @brief Offers the sink to produce an entry without its data, e.g. from content it already has.
+  /// @details Called before `Begin`. If this returns true, the entry is complete and neither decoded nor passed to
+  /// `Begin`, `Write` or `End`.
+  /// @param name Relative name of the entry.
+  /// @param size Uncompressed size of the entry, as recorded in the archive.
+  /// @param crc CRC-32 of the entry, as recorded in the archive.
+  /// @return true if the entry is complete.
+  virtual bool Reuse(const std::filesystem::path& name, uint64_t size, uint32_t crc) { return false; }
+
+  /// @brief Starts a new entry.
+  /// @param name Relative name of the entry.
+  /// @param size Uncompressed size of the entry, as recorded in the archive.
+  /// @return false if the entry cannot be accepted.
+  virtual bool Begin(const std::filesystem::path& name, uint64_t size) = 0;
+
+  /// @brief Appends decoded data to the current entry.
+  /// @return false on write failure.
+  virtual bool Write(std::span<const uint8_t> data) = 0;
+
+  /// @brief Completes the current entry.
+  /// @param ok false if the entry failed to decode or verify; its data is incomplete or corrupt.
+  /// @return false on write failure.
+  virtual bool End(bool ok) = 0;
+
+  /// @brief Completes the extraction.
+  /// @return false on write failure.
+  virtual bool Finish() { return true; }
+};
+
+/// @brief Returns whether the file at `path` has the given size and CRC-32. Reads the file only if the size matches.
+bool file_has_content(const std::filesystem::path& path, uint64_t size, uint32_t crc);
+
+/// @brief Writes every entry to its own file below a root directory, creating directories as needed.
+/// @details In sync mode, given a `sync_time`, every file written is stamped with that time, and an entry whose target
+/// has the entry's size, that modification time (as rounded by the destination filesystem, e.g. to 2 seconds on FAT)
+/// and the entry's CRC is left alone, without decoding it; re-extracting an unchanged tree then only reads it back.
+/// Callers pass the archive's modification time, so only files written by an earlier sync of the same archive, and not
+/// modified since, are trusted; size and time are checked before the CRC is computed. Other targets are replaced by a
+/// new file, never overwritten in place, so that files linked to them keep their content. Zero-filled blocks of
+/// `kHoleBlock` bytes, aligned to the file offset, are skipped rather than written, leaving holes on filesystems with
+/// sparse file support (disk images are often mostly zeros). Where the file cannot be made sparse, the zeros are
+/// written as usual.
+class FileSink : public ExtractSink {
+ public:
+  /// @brief Size and alignment of the zero-filled blocks turned into holes.
+  static constexpr size_t kHoleBlock = 64 * 1024;
+
+  /// @param root Directory the entries are written to.
+  /// @param sync_time Time to stamp files with in sync mode; nullopt to write every entry.
+  explicit FileSink(std::filesystem::path root, std::optional<std::filesystem::file_time_type> sync_time = std::nullopt)
+      : root_(std::move(root)), sync_time_(sync_time) {}
+  ~FileSink() override;
+
+  FileSink(const FileSink&) = delete;
+  FileSink& operator=(const FileSink&) = delete;
+
+  bool Reuse(const std::filesystem::path& name, uint64_t size, uint32_t crc) override;
+  bool Begin(const std::filesystem::path& name, uint64_t size) override;
+  bool Write(std::span<const uint8_t> data) override;
+  bool End(bool ok) override;
+
+  /// @brief Returns the directory entries are written to.
+  const std::filesystem::path& root() const { return root_; }
+
+  /// @brief Returns the path of the file most recently started.
+  const std::filesystem::path& current_path() const { return current_path_; }
+
+ protected:
+  /// @brief Returns whether the file at `path` carries the sync time, as files written by this sink do, at the
+  /// precision its filesystem stores times with. Always true outside sync mode.
+  bool HasSyncTime(const std::filesystem::path& path);
+
+ private:
+  /// @brief Returns whether the current file can hold holes, marking it sparse on first use.
+  bool CanSkipZeros();
+
+  std::filesystem::path root_;
+  std::optional<std::filesystem::file_time_type> sync_time_;
+  // The sync time as the destination stores it; found on first need.
+  std::optional<std::filesystem::file_time_type> stored_sync_time_;
+  std::filesystem::path current_path_;
+  std::FILE* file_{};
+  // Offset in the current file of the next byte to be written or skipped.
+  uint64_t offset_{};
+  // Zero bytes skipped since the last write.
+  uint64_t pending_zeros_{};
+  std::optional<bool> sparse_;
+};
+
+/// @brief Concatenates the data of all entries onto a stream, e.g. a pipe to another tool.
+class StreamSink : public ExtractSink {
+ public:
+  explicit StreamSink(std::ostream& stream) : stream_(stream) {}
+
+  bool Begin(const std::filesystem::path& name, uint64_t size) override { return stream_.good(); }
+  bool Write(std::span<const uint8_t> data) override;
+  bool End(bool ok) override { return stream_.good(); }
+  bool Finish() override;
+
+ private:
+  std::ostream& stream_;
+};
+
+/// @brief Streams all entries into a single ustar archive, in one pass.
+/// @details Entries that fail to decode are padded with zeros up to their recorded size, keeping the stream valid.
+class TarSink : public ExtractSink {
+ public:
+  explicit TarSink(std::ostream& stream) : stream_(stream) {}
+
+  bool Begin(const std::filesystem::path& name, uint64_t size) override;
+  bool Write(std::span<const uint8_t> data) override;
+  bool End(bool ok) override;
+  bool Finish() override;
+
+ private:
+  /// @brief Writes `count` zero bytes.
+  bool WriteZeros(uint64_t count);
+
+  std::ostream& stream_;
+  uint64_t size_{};
+  uint64_t written_{};
+};
@@ -0,0 +1,150 @@
+#include "memory_governor.hh"
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+
+uint64_t initial_budget() {
+  if (const char* mebibytes = std::getenv("OPUSLZX_MEMORY_BUDGET"); mebibytes && *mebibytes) {
+    if (auto value = std::strtoull(mebibytes, nullptr, 10))
+      return value << 20;
+  }
+  return MemoryGovernor::kDefaultBudget;
+}
+
+}  // namespace
+
+MemoryGovernor::Lease::Lease(Priority priority, uint64_t bytes) : priority_(priority), bytes_(bytes) {
+  Instance().Charge(priority_, bytes_);
+}
+
+MemoryGovernor::Lease& MemoryGovernor::Lease::operator=(Lease&& other) noexcept {
+  if (this != &other) {
+    if (bytes_)
+      Instance().Credit(priority_, bytes_);
+    priority_ = other.priority_;
+    bytes_ = std::exchange(other.bytes_, 0);
+  }
+  return *this;
+}
+
+MemoryGovernor::Lease::~Lease() {
+  if (bytes_)
+    Instance().Credit(priority_, bytes_);
+}
+
+MemoryGovernor::Registration& MemoryGovernor::Registration::operator=(Registration&& other) noexcept {
+  if (this != &other) {
+    if (id_)
+      Instance().Unregister(id_);
+    id_ = std::exchange(other.id_, 0);
+  }
+  return *this;
+}
+
+MemoryGovernor::Registration::~Registration() {
+  if (id_)
+    Instance().Unregister(id_);
+}
+
+void MemoryGovernor::Registration::Touch() {
+  if (id_)
+    Instance().Touch(id_);
+}
+
+MemoryGovernor& MemoryGovernor::Instance() {
+  // Never destroyed: leases and registrations may outlive static destruction while the plugin unloads.
+  static auto* governor = new MemoryGovernor();
+  return *governor;
+}
+
+MemoryGovernor::MemoryGovernor() : budget_(initial_budget()) {}
+
+void MemoryGovernor::SetBudget(uint64_t bytes) {
+  budget_ = bytes;
+  if (usage_ > budget_)
+    Reclaim();
+}
+
+void MemoryGovernor::Charge(Priority priority, uint64_t bytes) {
+  usage_by_priority_[static_cast<size_t>(priority)] += bytes;
+  auto usage = usage_ += bytes;
+
+  auto peak = peak_.load(std::memory_order_relaxed);
+  while (usage > peak && !peak_.compare_exchange_weak(peak, usage, std::memory_order_relaxed)) {
+  }
+
+  if (usage > budget_)
+    Reclaim();
+}
+
+void MemoryGovernor::Credit(Priority priority, uint64_t bytes) {
+  usage_by_priority_[static_cast<size_t>(priority)] -= bytes;
+  usage_ -= bytes;
+}
+
+MemoryGovernor::Registration MemoryGovernor::Register(Priority priority, Reclaimer reclaimer) {
+  std::lock_guard lock(mutex_);
+  auto id = next_id_++;
+  consumers_.emplace(id, Consumer{priority, std::move(reclaimer), Clock::now().time_since_epoch().count()});
+  return Registration(id);
+}
+
+void MemoryGovernor::Unregister(size_t id) {
+  std::lock_guard reclaim_lock(reclaim_mutex_);
+  std::lock_guard lock(mutex_);
+  consumers_.erase(id);
+}
+
+void MemoryGovernor::Touch(size_t id) {
+  std::lock_guard lock(mutex_);
+  if (auto iter = consumers_.find(id); iter != consumers_.end())
+    iter->second.last_use_ = Clock::now().time_since_epoch().count();
+}
+
+void MemoryGovernor::Reclaim() {
+  std::unique_lock reclaim_lock(reclaim_mutex_, std::try_to_lock);
+  // Also skipped when a reclaimer, on this thread, charges memory while releasing some.
+  if (!reclaim_lock || reclaiming_)
+    return;
+  reclaiming_ = true;
+  ++reclaims_;
+
+  // Reclaim order: by priority, then least recently used first.
+  std::vector<size_t> order;
+  {
+    std::lock_guard lock(mutex_);
+    for (const auto& [id, consumer] : consumers_)
+      order.push_back(id);
+    std::ranges::sort(order, {}, [this](size_t id) {
+      const auto& consumer = consumers_.find(id)->second;
+      return std::pair(consumer.priority_, consumer.last_use_);
+    });
+  }
+
+  for (auto id : order) {
+    if (usage_ <= budget_)
+      break;
+
+    // Looked up again: an earlier reclaimer may have dropped the last reference to this consumer.
+    Reclaimer reclaimer;
+    {
+      std::lock_guard lock(mutex_);
+      auto iter = consumers_.find(id);
+      if (iter == consumers_.end())
+        continue;
+      reclaimer = iter->second.reclaimer_;
+    }
+    reclaimer();
+  }
+  reclaiming_ = false;
+}
+
+MemoryGovernor::Stats MemoryGovernor::GetStats() const {
+  Stats stats{budget_, usage_, peak_, {}, reclaims_};
+  for (size_t priority = 0; priority < stats.usage_by_priority_.size(); ++priority)
+    stats.usage_by_priority_[priority] = usage_by_priority_[priority];
+  return stats;
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+/// @brief Process-wide memory budget shared by all plugin instances.
+/// @details Every cache and buffer of the plugin charges what it holds against one budget. Once a charge takes the
+/// total over budget, the governor asks the registered reclaimers to give memory back, lowest `Priority` first and,
+/// within a priority, least recently used first, until the total fits again. Memory in active use cannot be reclaimed,
+/// so the budget is a target rather than a hard limit; consumers that can do without memory (e.g. read-ahead) should
+/// check `HasRoom` before taking more.
+class MemoryGovernor {
+ public:
+  /// @brief Kinds of memory, in the order they are reclaimed.
+  enum class Priority : size_t {
+    // Idle pooled buffers; free to drop.
+    kBuffers,
+    // Opened archives; reopened on next use.
+    kArchives,
+    kCount,
+  };
+
+  /// @brief Default budget, unless overridden by the `OPUSLZX_MEMORY_BUDGET` environment variable (in MiB).
+  static constexpr uint64_t kDefaultBudget = uint64_t{512} << 20;
+
+  /// @brief Releases what it can of the memory of one consumer. Called on an arbitrary thread; must not block.
+  using Reclaimer = std::function<void()>;
+
+  /// @brief Memory charged against the budget, credited back on destruction. Move-only.
+  class Lease {
+   public:
+    Lease() = default;
+    Lease(Priority priority, uint64_t bytes);
+    Lease(Lease&& other) noexcept { *this = std::move(other); }
+    Lease& operator=(Lease&& other) noexcept;
+    ~Lease();
+
+   private:
+    Priority priority_{};
+    uint64_t bytes_{};
+  };
+
+  /// @brief Registered reclaimer, unregistered on destruction. Move-only.
+  class Registration {
+   public:
+    Registration() = default;
+    Registration(Registration&& other) noexcept : id_(std::exchange(other.id_, 0)) {}
+    Registration& operator=(Registration&& other) noexcept;
+    ~Registration();
+
+    /// @brief Marks the consumer as used now, moving it to the back of its priority's reclaim order.
+    void Touch();
+
+   private:
+    friend class MemoryGovernor;
+    explicit Registration(size_t id) : id_(id) {}
+
+    size_t id_{};
+  };
+
+  /// @brief Snapshot of the governor's counters.
+  struct Stats {
+    uint64_t budget_;
+    uint64_t usage_;
+    uint64_t peak_;
+    std::array<uint64_t, static_cast<size_t>(Priority::kCount)> usage_by_priority_;
+    // Number of times usage went over budget and reclaimers ran.
+    uint64_t reclaims_;
+  };
+
+  /// @brief Returns the governor.
+  static MemoryGovernor& Instance();
+
+  MemoryGovernor(const MemoryGovernor&) = delete;
+  MemoryGovernor& operator=(const MemoryGovernor&) = delete;
+
+  /// @brief Sets the budget, reclaiming at once if usage exceeds it.
+  void SetBudget(uint64_t bytes);
+
+  /// @brief Returns true if `bytes` more fit within the budget.
+  bool HasRoom(uint64_t bytes) const { return usage_ + bytes <= budget_; }
+
+  /// @brief Charges memory against the budget, reclaiming if it no longer fits.
+  void Charge(Priority priority, uint64_t bytes);
+
+  /// @brief Returns memory charged with `Charge`.
+  void Credit(Priority priority, uint64_t bytes);
+
+  /// @brief Registers a reclaimer for memory of the given priority.
+  Registration Register(Priority priority, Reclaimer reclaimer);
+
+  /// @brief Returns a snapshot of the counters.
+  Stats GetStats() const;
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  struct Consumer {
+    Priority priority_;
+    Reclaimer reclaimer_;
+    Clock::rep last_use_;
+  };
+
+  MemoryGovernor();
+
+  /// @brief Runs reclaimers until usage fits the budget. Returns at once if another thread is already reclaiming.
+  void Reclaim();
+
+  void Unregister(size_t id);
+  void Touch(size_t id);
+
+  std::atomic<uint64_t> budget_;
+  std::atomic<uint64_t> usage_{};
+  std::atomic<uint64_t> peak_{};
+  std::array<std::atomic<uint64_t>, static_cast<size_t>(Priority::kCount)> usage_by_priority_{};
+  std::atomic<uint64_t> reclaims_{};
+
+  // Held for a whole reclaim pass, and by `Unregister`, so that no reclaimer is destroyed while it runs. Recursive, as
+  // a reclaimer may drop the last reference to a consumer that unregisters.
+  std::recursive_mutex reclaim_mutex_;
+  bool reclaiming_{};
+  // Guards `consumers_` and `next_id_`.
+  std::mutex mutex_;
+  std::map<size_t, Consumer> consumers_;
+  size_t next_id_{1};
+};
@@ -0,0 +1,46 @@
+#include "merge_groups.hh"
+
+#include <array>
+#include <cstdint>
+#include <fstream>
+
+namespace {
+
+constexpr size_t kArchiveHeaderSize = 10;
+constexpr size_t kEntryHeaderSize = 31;
+
+uint32_t get_le32(const uint8_t* in) {
+  return in[0] | (in[1] << 8) | (in[2] << 16) | (static_cast<uint32_t>(in[3]) << 24);
+}
+
+}  // namespace
+
+std::optional<std::vector<std::vector<std::string>>> read_merge_groups(const std::filesystem::path& archive) {
+  std::ifstream stream(archive, std::ios::binary);
+  std::array<char, kArchiveHeaderSize> signature{};
+  if (!stream.read(signature.data(), signature.size()) || signature[0] != 'L' || signature[1] != 'Z' ||
+      signature[2] != 'X')
+    return std::nullopt;
+
+  std::vector<std::vector<std::string>> groups;
+  std::vector<std::string> pending;
+  std::array<uint8_t, kEntryHeaderSize> header;
+  while (stream.read(reinterpret_cast<char*>(header.data()), header.size())) {
+    uint32_t pack_size = get_le32(&header[6]);
+    std::string name(header[30], '\0');
+    if (!stream.read(name.data(), name.size()) || !stream.ignore(header[14]))
+      break;
+
+    pending.push_back(std::move(name));
+    if (pack_size == 0)
+      continue;
+    groups.push_back(std::move(pending));
+    pending.clear();
+    if (!stream.seekg(pack_size, std::ios::cur))
+      break;
+  }
+  // Entries still waiting for their packed data belong to a group cut short.
+  if (!pending.empty())
+    groups.push_back(std::move(pending));
+  return groups;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+/// @brief Reads which entries of an LZX archive share a compressed stream.
+/// @details The decoder does not expose merge groups, so the entry headers are read directly. A header with a packed
+/// size of 0 is merged with the entries that follow it, up to and including the next one with packed data; that data
+/// is the one stream all of them decode from. Only headers are read; packed data is skipped.
+/// @param archive Path to the archive file.
+/// @return Entry names as stored in the archive (the keys of `Unlzx::list_archive()`), one list per merge group, both
+/// in archive order; an unmerged entry forms a group of its own. nullopt if the file is not an LZX archive. A truncated
+/// archive yields the groups read up to the point of truncation.
+std::optional<std::vector<std::vector<std::string>>> read_merge_groups(const std::filesystem::path& archive);
@@ -1,60 +1,49 @@
 #include <strsafe.h>
 
-#include <cwctype>
+#include <atomic>
+#include <cstdlib>
+#include <cwchar>
 #include <memory>
+#include <optional>
+#include <string_view>
 
+#include "buffer_pool.hh"
+#include "content_index.hh"
 #include "dopus_wstring_view_span.hh"
 #include "stdafx.h"
 #include "text_utils.hh"
 
-// unlzx
-#include "error.hh"
-
 DOpusPluginHelperFunction DOpus;
 
-// --- Directory Structure & Navigation ---
-
-void Plugin::ReconstructDirStructure() {
-  mRoot = std::make_shared<DirEnt>();
-  mCurrentDir = mRoot.get();
-
-  if (!mArchive)
-    return;
-
-  mFlatMap = std::make_shared<std::map<std::string, LzxEntry>>(mArchive->list_archive());
-  for (auto& [name, entry] : *mFlatMap) {
-    std::filesystem::path path(name);
-
-    DirEnt* insertion_point = mRoot.get();
-    for (auto segment : path) {
-      insertion_point = &insertion_point->children_[segment.string()];
-    }
-    insertion_point->file_ = &entry;
-  }
+namespace {
+
+/// @brief Returns whether sync mode is enabled, for all plugin instances.
+/// @details Sync mode is opt-in, since it trusts existing files that look unchanged. It starts out enabled if the
+/// `OPUSLZX_SYNC` environment variable is set to 1, and is switched with the Plugin::kSyncVerb context verb.
+std::atomic<bool>& sync_enabled() {
+  static std::atomic<bool> enabled = [] {
+    const char* value = std::getenv("OPUSLZX_SYNC");
+    return value && std::string_view(value) == "1";
+  }();
+  return enabled;
 }
 
-bool Plugin::ChangeDir(std::filesystem::path dir) {
-  dir = sanitize(std::move(dir));
-  auto maybe_path = LoadFile(std::move(dir));
-  if (!maybe_path)
-    return false;
-
-  mCurrentDir = mRoot.get();
-  if (*maybe_path == ".")
-    return true;
+/// @brief Returns the time to stamp extracted files with in sync mode, or nullopt unless sync mode is enabled.
+/// @details Files are stamped with the archive's modification time (see FileSink).
+std::optional<std::filesystem::file_time_type> sync_time(const std::filesystem::path& archive) {
+  if (!sync_enabled())
+    return std::nullopt;
 
-  for (auto segment : *maybe_path) {
-    auto iter = mCurrentDir->children_.find(segment.string());
-    if (iter == mCurrentDir->children_.end())
-      return false;
-    mCurrentDir = &iter->second;
-  }
-  return true;
+  std::error_code error;
+  auto time = std::filesystem::last_write_time(archive, error);
+  return error ? std::nullopt : std::optional(time);
 }
 
+}  // namespace
+
 // --- Entry Information ---
 
-LPVFSFILEDATAHEADER Plugin::GetVFSforEntry(const std::string& name, const DirEnt& entry, HANDLE heap) {
+LPVFSFILEDATAHEADER Plugin::GetVFSforEntry(std::string_view name, const DirEnt& entry, HANDLE heap) {
   LPVFSFILEDATAHEADER node;
 
   node = static_cast<LPVFSFILEDATAHEADER>(HeapAlloc(heap, 0, sizeof(VFSFILEDATAHEADER) + sizeof(VFSFILEDATA)));
@@ -78,9 +67,8 @@ LPVFSFILEDATAHEADER Plugin::GetVFSforEntry(const std::string& name, const DirEnt
   return node;
 }
 
-void Plugin::GetWfdForEntry(const std::string& name, const DirEnt& entry, LPWIN32_FIND_DATAW data) {
-  auto wname = utf8_to_wstring(name);
-  StringCchCopyW(data->cFileName, MAX_PATH, wname.c_str());
+void Plugin::GetWfdForEntry(std::string_view name, const DirEnt& entry, LPWIN32_FIND_DATAW data) {
+  utf8_to_wide(name, data->cFileName);
 
   data->nFileSizeHigh = 0;
   if (entry.file_) {
@@ -100,6 +88,25 @@ void Plugin::GetWfdForEntry(const std::string& name, const DirEnt& entry, LPWIN3
 
 // --- State Management & Helpers ---
 
+// Per-call state (abort event, content index) is not copied.
+Plugin::Plugin(const Plugin& other) : PluginCore(other) {}
+
+std::wstring Plugin::MemoryReport() const {
+  constexpr double kMebibyte = 1 << 20;
+  auto governor = MemoryGovernor::Instance().GetStats();
+  auto pool = BufferPool::Instance().GetStats();
+
+  wchar_t report[512];
+  StringCchPrintfW(report, std::size(report),
+                   L"Budget: %.1f MiB\nIn use: %.1f MiB (peak %.1f MiB)\n  Archives: %.1f MiB\n"
+                   L"  Buffers: %.1f MiB, of which %.1f MiB idle\nOver budget: %llu times",
+                   governor.budget_ / kMebibyte, governor.usage_ / kMebibyte, governor.peak_ / kMebibyte,
+                   governor.usage_by_priority_[static_cast<size_t>(MemoryGovernor::Priority::kArchives)] / kMebibyte,
+                   governor.usage_by_priority_[static_cast<size_t>(MemoryGovernor::Priority::kBuffers)] / kMebibyte,
+                   pool.idle_bytes_ / kMebibyte, static_cast<unsigned long long>(governor.reclaims_));
+  return report;
+}
+
 Guard<HANDLE> Plugin::SetAbortHandle(HANDLE& hAbortEvent) {
   return Guard<HANDLE>(mAbortEvent, hAbortEvent);
 }
@@ -108,58 +115,8 @@ bool Plugin::ShouldAbort() const {
   return mAbortEvent && WaitForSingleObject(mAbortEvent, 0) == WAIT_OBJECT_0;
 }
 
-void Plugin::SetError(int error) {
-  mLastError = error;
-  ::SetLastError(error);
-}
-
 // --- Initialization & Archive Info ---
 
-std::optional<std::filesystem::path> Plugin::LoadFile(std::filesystem::path path) {
-  path = sanitize(std::move(path));
-  SetError(0);
-
-  if (!mPath.empty() && is_subpath(mPath, path)) {
-    // Path is already loaded, no need to check again.
-    return std::filesystem::relative(path, mPath);
-  }
-
-  // Loading new file. Should we cache this?
-  mPath.clear();
-  mArchive.reset();
-
-  SetError(ERROR_FILE_NOT_FOUND);
-
-  // Walk the pAdfPath up until we find the valid file.
-  std::filesystem::path real_file_path = path;
-  while (!real_file_path.empty()) {
-    if (std::filesystem::exists(real_file_path))
-      break;
-    real_file_path = real_file_path.parent_path();
-  }
-
-  if (real_file_path.empty())
-    return {};
-
-  // Get extension and check if it's supported.
-  auto extension = real_file_path.extension().wstring();
-  std::ranges::transform(extension, extension.begin(), std::towlower);
-  if (extension != L".lzx")
-    return {};
-
-  auto utf_file_path = real_file_path.string();
-
-  mArchive = std::make_shared<Unlzx>();
-  Status result = mArchive->open_archive(utf_file_path.c_str());
-  if (result != Status::Ok)
-    return {};
-
-  SetError(0);
-  mPath = real_file_path;
-  ReconstructDirStructure();
-  return std::filesystem::relative(path, mPath);
-}
-
 size_t Plugin::GetAvailableSize() {
   /* Not implemented */
   return {};
@@ -180,7 +137,9 @@ bool Plugin::ReadDirectory(LPVFSREADDIRDATAW lpRDD) {
   if (lpRDD->vfsReadOp == VFSREAD_FREEDIR)
     return true;
 
-  if (!ChangeDir(lpRDD->lpszPath))
+  // Opening the archive may take a while; let the lister cancel it.
+  auto abort_guard = SetAbortHandle(lpRDD->hAbortEvent);
+  if (!ChangeDir(ArchivePath(lpRDD->lpszPath)))
     return false;
 
   if (lpRDD->vfsReadOp == VFSREAD_CHANGEDIR)
@@ -205,93 +164,54 @@ bool Plugin::ReadDirectory(LPVFSREADDIRDATAW lpRDD) {
   return true;
 }
 
-// --- File I/O ---
-
-PluginFile* Plugin::OpenFile(std::filesystem::path path, bool for_writing) {
-  path = sanitize(std::move(path));
-  if (!ChangeDir(path.parent_path()))
-    return {};
-
-  if (for_writing)
-    return {};
-
-  auto iter = mCurrentDir->children_.find(path.filename().string());
-  if (iter == mCurrentDir->children_.end())
-    return {};
-  if (!iter->second.file_)
-    return {};
-
-  auto result = new PluginFile();
-  result->file_ = iter->second.file_;
-  return result;
-}
-
-bool Plugin::ReadFile(PluginFile* file, std::span<uint8_t> buffer, LPDWORD read_size) {
-  SetError(0);
-  *read_size = 0;
-
-  if (file->offset_ >= file->file_->unpack_size())
-    return false;
-
-  // Locate segment to read from
-  size_t read_offset{file->offset_};
-  size_t segment_size{};
-
-  auto segment_iter = file->file_->segments().begin();
-  for (; segment_iter != file->file_->segments().end(); ++segment_iter) {
-    segment_size = segment_iter->decompressed_length();
-    // Locate first segment that has any relevant data.
-    if (read_offset < segment_size)
-      break;
-
-    read_offset -= segment_size;
-  }
-
-  if (segment_iter == file->file_->segments().end())
-    return false;
-
-  std::span<const uint8_t> data = segment_iter->data();
-  if (data.empty()) {
-    SetError(ERROR_READ_FAULT);
-    return false;
-  }
-
-  *read_size = min(segment_size - read_offset, buffer.size());
-  ::memcpy(buffer.data(), &data[read_offset], *read_size);
-  file->offset_ += *read_size;
-
-  return true;
-}
-
-void Plugin::CloseFile(PluginFile* file) {
-  delete file;
-}
-
 // --- File Enumeration ---
 
 struct PluginFindData {
-  std::map<std::string, Plugin::DirEnt>::iterator current;
-  std::map<std::string, Plugin::DirEnt>::iterator end;
+  // Keeps the tree the iterators point into, and the archive, while enumerating; see PluginCore::DirTree.
+  std::shared_ptr<Plugin::DirEnt> root;
+  decltype(Plugin::DirEnt::children_)::iterator current;
+  decltype(Plugin::DirEnt::children_)::iterator end;
+  // Wildcard pattern the entries are matched against; empty if every entry should be listed.
+  std::string pattern;
+  // Literal part of the pattern preceding the first wildcard. All matches share this prefix.
+  std::string_view prefix;
 };
 
-PluginFindData* Plugin::FindFirst(std::filesystem::path path, LPWIN32_FIND_DATA lpwfdData, HANDLE hAbortEvent) {
-  SetError(0);
-  path = sanitize(std::move(path));
-
-  // We assume the pattern is always '*' (or similar), so we just list the directory.
-  if (!ChangeDir(path.parent_path())) {
+PluginFindData* Plugin::FindFirst(ArchivePath path, LPWIN32_FIND_DATA lpwfdData, HANDLE hAbortEvent) {
+  auto abort_guard = SetAbortHandle(hAbortEvent);
+  auto* dir = FindEntry(path.parent_path());
+  if (!dir) {
     SetError(ERROR_PATH_NOT_FOUND);
     return nullptr;
   }
 
   auto* find_data = new PluginFindData();
-  find_data->current = mCurrentDir->children_.begin();
-  find_data->end = mCurrentDir->children_.end();
+  find_data->root = mRoot;
+  char pattern[MAX_PATH * 3];
+  find_data->pattern.assign(pattern, wide_to_utf8(path.filename(), pattern));
+  if (find_data->pattern == "*" || find_data->pattern == "*.*")
+    find_data->pattern.clear();
+
+  auto& children = dir->children_;
+  if (!find_data->pattern.empty() && !has_wildcards(find_data->pattern)) {
+    // A plain name matches at most one entry; look it up directly.
+    find_data->current = children.find(std::string_view(find_data->pattern));
+    find_data->end = find_data->current == children.end() ? children.end() : std::next(find_data->current);
+    find_data->pattern.clear();
+  } else {
+    // Children are sorted by name, so all candidates for the pattern form a contiguous range starting at the literal
+    // prefix. Seek straight to it rather than walking the whole directory.
+    find_data->prefix = std::string_view(find_data->pattern).substr(0, find_data->pattern.find_first_of("*?"));
+    find_data->current = children.lower_bound(find_data->prefix);
+    find_data->end = children.end();
+  }
 
   if (FindNext(find_data, lpwfdData)) {
+    ++mOpenHandles;
     return find_data;
   }
 
+  SetError(ERROR_FILE_NOT_FOUND);
   delete find_data;
   return nullptr;
 }
@@ -303,56 +223,60 @@ bool Plugin::FindNext(PluginFindData* lpRAF, LPWIN32_FIND_DATA lpwfdData) {
     return false;
   }
 
-  if (lpRAF->current != lpRAF->end) {
+  while (lpRAF->current != lpRAF->end) {
     auto& [name, entry] = *lpRAF->current;
+    // Past the prefix range; nothing further can match.
+    if (!name.starts_with(lpRAF->prefix))
+      break;
+
     lpRAF->current++;
+    if (!lpRAF->pattern.empty() && !wildcard_match(lpRAF->pattern, name))
+      continue;
 
     GetWfdForEntry(name, entry, lpwfdData);
     return true;
   }
 
+  lpRAF->current = lpRAF->end;
   SetError(ERROR_NO_MORE_FILES);
   return false;
 }
 
 void Plugin::FindClose(PluginFindData* pFindData) {
+  if (pFindData)
+    --mOpenHandles;
   delete pFindData;
 }
 
 // --- File Information & Attributes ---
 
-LPVFSFILEDATAHEADER Plugin::GetfileInformation(std::filesystem::path path, HANDLE heap) {
-  SetError(ERROR_FILE_NOT_FOUND);
-  if (!ChangeDir(path.parent_path()))
+LPVFSFILEDATAHEADER Plugin::GetfileInformation(ArchivePath path, HANDLE heap) {
+  auto* node = FindEntry(path);
+  if (!node || node == mRoot.get()) {
+    SetError(ERROR_FILE_NOT_FOUND);
     return nullptr;
-  auto filename = path.filename().wstring();
-
-  auto iter = mCurrentDir->children_.find(path.filename().string());
-  if (iter == mCurrentDir->children_.end())
-    return {};
+  }
 
-  SetError(0);
-  return GetVFSforEntry(iter->first, iter->second, heap);
+  char name[MAX_PATH * 3];
+  auto length = wide_to_utf8(path.filename(), name);
+  return GetVFSforEntry(std::string_view(name, length), *node, heap);
 }
 
-bool Plugin::GetFileSize(std::filesystem::path path, PluginFile* file, uint64_t* piFileSize) {
-  path = sanitize(std::move(path));
-  if (!ChangeDir(path))
-    return false;
-
-  if (!mCurrentDir->file_)
+bool Plugin::GetFileSize(ArchivePath path, PluginFile* file, uint64_t* piFileSize) {
+  auto* node = FindEntry(path);
+  if (!node || !node->file_)
     return false;
 
-  *piFileSize = mCurrentDir->file_->unpack_size();
+  *piFileSize = node->file_->unpack_size();
   return true;
 }
 
-bool Plugin::GetFileAttr(std::filesystem::path path, LPDWORD pAttr) {
-  path = sanitize(std::move(path));
-  if (!ChangeDir(path))
+bool Plugin::GetFileAttr(ArchivePath path, LPDWORD pAttr) {
+  auto* node = FindEntry(path);
+  if (!node)
     return false;
 
-  if (mCurrentDir->file_) {
+  if (node->file_) {
     *pAttr = FILE_ATTRIBUTE_NORMAL | FILE_ATTRIBUTE_COMPRESSED;
   } else {
     *pAttr = FILE_ATTRIBUTE_DIRECTORY;
@@ -364,15 +288,12 @@ bool Plugin::GetFileAttr(std::filesystem::path path, LPDWORD pAttr) {
 
 bool Plugin::Extract(LPVOID func_data, std::filesystem::path source_path, std::filesystem::path target_path) {
   source_path = sanitize(std::move(source_path));
-  if (!ChangeDir(source_path.parent_path()))
-    return false;
-
-  auto iter = mCurrentDir->children_.find(source_path.filename().string());
-  if (iter == mCurrentDir->children_.end())
+  auto* node = FindEntry(ArchivePath(source_path));
+  if (!node || node == mRoot.get())
     return false;
 
-  if (iter->second.file_) {
-    return ExtractFile(func_data, iter->second, target_path / source_path.filename());
+  if (node->file_) {
+    return ExtractFile(func_data, *node, target_path / source_path.filename());
   } else {
     return ExtractPath(func_data, source_path, target_path / source_path.filename());
   }
@@ -382,40 +303,34 @@ bool Plugin::ExtractFile(LPVOID func_data, const DirEnt& entry, std::filesystem:
   if (!entry.file_)
     return false;
 
-  std::filesystem::create_directories(target_path.parent_path());
-  std::ofstream target(target_path, std::ios_base::trunc | std::ios_base::out | std::ios_base::binary);
-  for (auto segment : entry.file_->segments()) {
-    if (target.bad())
-      break;
-
-    auto data = segment.data();
-
-    // Decompress failure.
-    if (segment.status() != Status::Ok)
-      break;
-
-    // Write failure.
-    target.write(reinterpret_cast<const char*>(data.data()), data.size());
+  // In sync mode, targets written by an earlier sync of this archive are left alone if they still look unchanged.
+  bool result;
+  if (mContentIndex) {
+    DedupFileSink sink(target_path.parent_path(), *mContentIndex, sync_time(mPath));
+    result = DecodeEntry(*entry.file_, target_path.filename(), sink);
+  } else {
+    FileSink sink(target_path.parent_path(), sync_time(mPath));
+    result = DecodeEntry(*entry.file_, target_path.filename(), sink);
   }
-  target.close();
   DOpus.AddFunctionFileChange(func_data, /* fIsDest= */ false, OPUSFILECHANGE_CREATE, target_path.c_str());
 
-  return true;
+  return result;
 }
 
 bool Plugin::ExtractPath(LPVOID func_data, std::filesystem::path source_path, std::filesystem::path target_path) {
   source_path = sanitize(std::move(source_path));
-  if (!ChangeDir(source_path))
+  auto* dir = FindEntry(ArchivePath(source_path));
+  if (!dir)
     return false;
 
   std::vector<std::string> children;
-  for (const auto& [name, entry] : mCurrentDir->children_) {
-    children.push_back(name);
+  for (const auto& [name, entry] : dir->children_) {
+    children.emplace_back(name);
   }
 
   bool success = true;
   for (const auto& child : children) {
-    if (!Extract(func_data, source_path / child, target_path)) {
+    if (!Extract(func_data, source_path / utf8_to_wstring(child), target_path)) {
       success = false;
     }
   }
@@ -423,27 +338,59 @@ bool Plugin::ExtractPath(LPVOID func_data, std::filesystem::path source_path, st
 }
 
 bool Plugin::ExtractEntries(LPVOID func_data, dopus::wstring_view_span entry_names, std::filesystem::path target_path) {
-  SetError(0);
+  // Trees that keep a content index get duplicates linked rather than written again.
+  auto index = ContentIndex::Load(target_path);
+  auto* index_ptr = index ? &*index : nullptr;
+  Guard<ContentIndex*> index_guard(mContentIndex, index_ptr);
+
+  // Every lookup resets the error, so keep the first failure to report once all entries are processed.
+  int error{};
   for (auto name : entry_names) {
     std::filesystem::path source_path = sanitize(name);
-    Extract(func_data, source_path, target_path);
+    if (!Extract(func_data, source_path, target_path) && !error)
+      error = mLastError ? mLastError : ERROR_READ_FAULT;
   }
 
-  return true;
+  if (index && !index->Save() && !error)
+    error = ERROR_WRITE_FAULT;
+
+  SetError(error);
+  return error == 0;
 }
 
 // --- Plugin API Specifics ---
 
 int Plugin::ContextVerb(LPVFSCONTEXTVERBDATAW lpVerbData) {
-  std::filesystem::path full_path = sanitize(lpVerbData->lpszPath);
-  if (!ChangeDir(full_path.parent_path()))
-    return VFSCVRES_FAIL;
+  if (lpVerbData->lpszVerb && std::wstring_view(lpVerbData->lpszVerb) == kMemoryVerb) {
+    if (lpVerbData->lpszArgs && *lpVerbData->lpszArgs) {
+      if (auto mebibytes = std::wcstoull(lpVerbData->lpszArgs, nullptr, 10))
+        MemoryGovernor::Instance().SetBudget(mebibytes << 20);
+    }
+    MessageBoxW(nullptr, MemoryReport().c_str(), L"LZX memory", MB_OK | MB_ICONINFORMATION);
+    return VFSCVRES_HANDLED;
+  }
 
-  auto item = mCurrentDir->children_.find(full_path.filename().string());
+  if (lpVerbData->lpszVerb && std::wstring_view(lpVerbData->lpszVerb) == kSyncVerb) {
+    std::wstring_view argument = lpVerbData->lpszArgs ? lpVerbData->lpszArgs : L"";
+    if (argument == L"on") {
+      sync_enabled() = true;
+    } else if (argument == L"off") {
+      sync_enabled() = false;
+    } else if (argument.empty()) {
+      MessageBoxW(nullptr,
+                  sync_enabled() ? L"Sync mode is on: unchanged files from an earlier sync are left alone."
+                                 : L"Sync mode is off: every file is extracted.",
+                  L"LZX sync", MB_OK | MB_ICONINFORMATION);
+    } else {
+      return VFSCVRES_FAIL;
+    }
+    return VFSCVRES_HANDLED;
+  }
 
-  if (item == mCurrentDir->children_.end())
+  auto* node = FindEntry(ArchivePath(lpVerbData->lpszPath));
+  if (!node || node == mRoot.get())
     return VFSCVRES_FAIL;
-  if (!item->second.file_)
+  if (!node->file_)
     return VFSCVRES_DEFAULT;
 
   return VFSCVRES_EXTRACT;
@@ -1,10 +1,16 @@
 #pragma once
 
 #include <filesystem>
-#include <optional>
-#include <set>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
 
+#include "archive_path.hh"
 #include "dopus_wstring_view_span.hh"
+#include "extract_sink.hh"
+#include "plugin_core.hh"
 #include "unlzx.hh"
 
 /// @brief Guard object to set and restore fields.
@@ -32,44 +38,18 @@ class Guard {
 /// @brief Opaque handle for file enumeration.
 struct PluginFindData;
 
-/// @brief Represents an open file within the archive.
-struct PluginFile {
-  LzxEntry* file_{};
-  size_t offset_{};
-};
-
-/// @brief Main plugin class handling LZX archive interactions.
-class Plugin {
- public:
-  struct DirEnt {
-    DirEnt() = default;
-    DirEnt(const DirEnt&) = delete;
-    DirEnt& operator=(const DirEnt&) = delete;
-
-    std::map<std::string, DirEnt> children_;
-    LzxEntry* file_{};
-  };
+class ContentIndex;
 
+/// @brief Main plugin class: the Directory Opus VFS interface over the platform-independent PluginCore.
+class Plugin : public PluginCore {
  private:
-
   using EntryType = void*;
   HANDLE mAbortEvent{};
-  std::filesystem::path mPath;
-  std::shared_ptr<Unlzx> mArchive;
-  std::shared_ptr<std::map<std::string, LzxEntry>> mFlatMap;
-  std::shared_ptr<DirEnt> mRoot;
-  DirEnt* mCurrentDir;
-  int mLastError{};
-
-  // --- Directory Structure & Navigation ---
+  // Index of the destination tree during ExtractEntries, if it keeps one.
+  ContentIndex* mContentIndex{};
 
-  /// @brief Re-reads the directory structure from the current archive, reconstructing mFlatMap and mRoot.
-  void ReconstructDirStructure();
-
-  /// @brief Navigate to a specific (absolute) path within the archive.
-  /// @param dir The absolute path to navigate to.
-  /// @return true if successful, false otherwise.
-  bool ChangeDir(std::filesystem::path dir);
+  /// @brief Formats the memory governor's counters for display.
+  std::wstring MemoryReport() const;
 
   // --- Entry Information ---
 
@@ -78,13 +58,13 @@ class Plugin {
   /// @param entry The directory entry.
   /// @param heap Handle to the heap for memory allocation.
   /// @return Pointer to the allocated VFSFILEDATAHEADER.
-  LPVFSFILEDATAHEADER GetVFSforEntry(const std::string& name, const DirEnt& entry, HANDLE heap);
+  LPVFSFILEDATAHEADER GetVFSforEntry(std::string_view name, const DirEnt& entry, HANDLE heap);
 
   /// @brief Populates WIN32_FIND_DATAW for a given directory entry.
   /// @param name The name of the entry.
   /// @param entry The directory entry.
   /// @param data Pointer to the WIN32_FIND_DATAW structure to populate.
-  void GetWfdForEntry(const std::string& name, const DirEnt& entry, LPWIN32_FIND_DATAW data);
+  void GetWfdForEntry(std::string_view name, const DirEnt& entry, LPWIN32_FIND_DATAW data);
 
   /// @brief Retrieves the file time for a given entry.
   /// @param entry The entry to retrieve the time for.
@@ -98,21 +78,22 @@ class Plugin {
   /// @return A Guard object managing the handle restoration.
   Guard<HANDLE> SetAbortHandle(HANDLE& hAbortEvent);
 
-  /// @brief Checks if an abort has been requested.
+  /// @brief Checks if the current abort event is signalled.
   /// @return true if abort was requested, false otherwise.
-  bool ShouldAbort() const;
-
-  /// @brief Sets the last error code.
-  /// @param error The error code to set.
-  void SetError(int error);
+  bool ShouldAbort() const override;
 
  public:
-  // --- Initialization & Archive Info ---
+  /// @brief Context verb showing the memory report. With an argument, first sets the memory budget, in MiB.
+  static constexpr const wchar_t* kMemoryVerb = L"lzxmemory";
+  /// @brief Context verb switching sync mode (see FileSink) for all instances, with `on` or `off`. Without an argument,
+  /// shows whether it is on.
+  static constexpr const wchar_t* kSyncVerb = L"lzxsync";
+
+  Plugin() = default;
+  Plugin(const Plugin& other);
+  Plugin& operator=(const Plugin&) = delete;
 
-  /// @brief Loads an LZX archive from the specified path.
-  /// @param pAfPath Path to the archive file.
-  /// @return Optional path to the loaded archive if successful.
-  std::optional<std::filesystem::path> LoadFile(std::filesystem::path path);
+  // --- Archive Info ---
 
   /// @brief Returns the available size in the archive.
   /// @return The available size in bytes.
@@ -122,10 +103,6 @@ class Plugin {
   /// @return The total size in bytes.
   size_t GetTotalSize();
 
-  /// @brief Returns the last error that occurred.
-  /// @return The last error code.
-  int GetError() const { return mLastError; }
-
   // --- Directory Reading ---
 
   /// @brief Reads the contents of the current directory into the VFS.
@@ -133,25 +110,6 @@ class Plugin {
   /// @return true if successful, false otherwise.
   bool ReadDirectory(LPVFSREADDIRDATAW lpRDD);
 
-  // --- File I/O ---
-
-  /// @brief Opens a file within the archive.
-  /// @param path The path of the file to open.
-  /// @param for_writing true if opening for writing, false for reading.
-  /// @return Pointer to the opened PluginFile.
-  PluginFile* OpenFile(std::filesystem::path path, bool for_writing);
-
-  /// @brief Reads data from an open file.
-  /// @param pFile Pointer to the open file.
-  /// @param buffer Buffer to read data into.
-  /// @param readSize Pointer to a DWORD to receive the number of bytes read.
-  /// @return true if successful, false otherwise.
-  bool ReadFile(PluginFile* pFile, std::span<uint8_t> buffer, LPDWORD readSize);
-
-  /// @brief Closes an open file.
-  /// @param pFile Pointer to the file to close.
-  void CloseFile(PluginFile* pFile);
-
   // --- File Enumeration ---
 
   /// @brief Begins a file enumeration in the specified path.
@@ -159,7 +117,7 @@ class Plugin {
   /// @param lpwfdData Pointer to WIN32_FIND_DATA structure to receive the first file's data.
   /// @param hAbortEvent Handle to an abort event.
   /// @return Pointer to a PluginFindData handle.
-  PluginFindData* FindFirst(std::filesystem::path path, LPWIN32_FIND_DATA lpwfdData, HANDLE hAbortEvent);
+  PluginFindData* FindFirst(ArchivePath path, LPWIN32_FIND_DATA lpwfdData, HANDLE hAbortEvent);
 
   /// @brief Continues a file enumeration.
   /// @param lpRAF Pointer to the PluginFindData handle.
@@ -177,20 +135,20 @@ class Plugin {
   /// @param path The path to the file.
   /// @param heap Handle to the heap for memory allocation.
   /// @return Pointer to the allocated VFSFILEDATAHEADER.
-  LPVFSFILEDATAHEADER GetfileInformation(std::filesystem::path path, HANDLE heap);
+  LPVFSFILEDATAHEADER GetfileInformation(ArchivePath path, HANDLE heap);
 
   /// @brief Gets the size of a file.
   /// @param path The path to the file.
   /// @param file Optional pointer to an already opened PluginFile.
   /// @param piFileSize Pointer to receive the file size.
   /// @return true if successful, false otherwise.
-  bool GetFileSize(std::filesystem::path path, PluginFile* file, uint64_t* piFileSize);
+  bool GetFileSize(ArchivePath path, PluginFile* file, uint64_t* piFileSize);
 
   /// @brief Gets the attributes of a file.
   /// @param path The path to the file.
   /// @param pAttr Pointer to receive the attributes.
   /// @return true if successful, false otherwise.
-  bool GetFileAttr(std::filesystem::path path, LPDWORD pAttr);
+  bool GetFileAttr(ArchivePath path, LPDWORD pAttr);
 
   // --- Extraction ---
 
@@ -0,0 +1,567 @@
+#include "plugin_core.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <ranges>
+#include <thread>
+#include <unordered_map>
+
+#include "archive_loader.hh"
+#include "archive_root_cache.hh"
+#include "content_matcher.hh"
+#include "crc32.hh"
+#include "merge_groups.hh"
+#include "system_errors.hh"
+#include "text_utils.hh"
+
+// unlzx
+#include "error.hh"
+
+namespace {
+
+// Longest name of a single path component, in UTF-8: MAX_PATH UTF-16 units of up to three bytes each.
+constexpr size_t kMaxNameBytes = 260 * 3;
+
+// Upper bound on threads searching one archive. Each opens the archive again, which costs its memory once more.
+constexpr size_t kMaxSearchWorkers = 8;
+
+}  // namespace
+
+// --- Directory Structure & Navigation ---
+
+std::vector<std::pair<std::filesystem::path, LzxEntry*>> PluginCore::CollectFiles(const DirEnt& dir,
+                                                                               std::filesystem::path name) {
+  std::vector<std::pair<std::filesystem::path, LzxEntry*>> entries;
+  std::vector<std::pair<std::filesystem::path, const DirEnt*>> pending{{std::move(name), &dir}};
+  while (!pending.empty()) {
+    auto [node_name, node] = std::move(pending.back());
+    pending.pop_back();
+
+    if (node->file_)
+      entries.emplace_back(node_name, node->file_);
+    // Push in reverse so that entries are visited in name order.
+    for (const auto& [child_name, child] : std::views::reverse(node->children_))
+      pending.emplace_back(node_name / utf8_to_path(child_name), &child);
+  }
+  return entries;
+}
+
+PluginCore::DirTree::DirTree(size_t size_hint) : arena_(std::max<size_t>(size_hint * 128, 4096)) {
+  // Root node lives in the arena alongside the rest of the tree, and, like the rest, is never destroyed.
+  root_ = std::pmr::polymorphic_allocator<>(&arena_).new_object<DirEnt>();
+}
+
+void PluginCore::ReconstructDirStructure() {
+  if (!mArchive) {
+    auto tree = std::make_shared<DirTree>(0);
+    mRoot = std::shared_ptr<DirEnt>(tree, tree->root_);
+    mCurrentDir = mRoot.get();
+    return;
+  }
+
+  auto tree = std::make_shared<DirTree>(mFlatMap->size());
+  tree->entries_ = mFlatMap;
+  for (auto& [name, entry] : *mFlatMap) {
+    // Names come straight from the archive and may be corrupt or hostile. Entries that would resolve outside their
+    // directory (`..`, drive or volume specifiers) are left out of the tree, so they can be neither listed nor
+    // extracted. Both separators are honoured, since either splits the path once it reaches Windows.
+    std::string_view remaining(name);
+    DirEnt* insertion_point = tree->root_;
+    while (insertion_point && !remaining.empty()) {
+      auto component = remaining.substr(0, remaining.find_first_of("/\\"));
+      remaining.remove_prefix(std::min(component.size() + 1, remaining.size()));
+      if (component.empty() || component == ".")
+        continue;
+      if (component == ".." || component.find(':') != std::string_view::npos) {
+        insertion_point = nullptr;
+        break;
+      }
+
+      auto& children = insertion_point->children_;
+      auto iter = children.lower_bound(component);
+      if (iter == children.end() || iter->first != component) {
+        iter = children.emplace_hint(iter, std::piecewise_construct, std::forward_as_tuple(component),
+                                     std::forward_as_tuple());
+      }
+      insertion_point = &iter->second;
+    }
+
+    if (insertion_point && insertion_point != tree->root_)
+      insertion_point->file_ = &entry;
+  }
+
+  mRoot = std::shared_ptr<DirEnt>(tree, tree->root_);
+  mCurrentDir = mRoot.get();
+}
+
+bool PluginCore::ChangeDir(ArchivePath dir) {
+  auto* node = FindEntry(dir);
+  if (!node)
+    return false;
+
+  mCurrentDir = node;
+  return true;
+}
+
+PluginCore::DirEnt* PluginCore::FindEntry(ArchivePath path) {
+  SetError(0);
+
+  // Fast path: the path lies within the loaded archive and is in normal form, so it can be walked in place.
+  std::optional<ArchivePath> relative;
+  if (!mPath.empty())
+    relative = path.relative_to(ArchivePath(mPath));
+
+  // Anything else goes through LoadFile, which normalizes the path and locates the archive on disk.
+  std::optional<std::filesystem::path> loaded;
+  if (!relative) {
+    loaded = LoadFile(std::filesystem::path(path.native()));
+    if (!loaded)
+      return nullptr;
+    relative = ArchivePath(*loaded);
+  }
+
+  DirEnt* node = mRoot.get();
+  ArchivePath::string_view_type node_name;
+  for (auto component : *relative) {
+    char name[kMaxNameBytes];
+    auto length = native_to_utf8(component, name);
+    auto iter = node->children_.find(std::string_view(name, length));
+    if (iter == node->children_.end()) {
+      // A node may be both a file and a directory prefix of other entries, so this is only known to descend into a
+      // file once no child matched. Archives nested within the loaded one cannot be browsed in place: Unlzx only
+      // opens archives from disk.
+      if (node->file_)
+        SetError(is_archive_name(node_name) ? ERROR_NOT_SUPPORTED : ERROR_PATH_NOT_FOUND);
+      else
+        SetError(ERROR_FILE_NOT_FOUND);
+      return nullptr;
+    }
+    node = &iter->second;
+    node_name = component;
+  }
+  return node;
+}
+
+// --- State Management & Helpers ---
+
+PluginCore::PluginCore()
+    : mResidency(MemoryGovernor::Instance().Register(MemoryGovernor::Priority::kArchives, [this] { Evict(); })) {}
+
+// Shares the loaded archive and position. Calls in progress and open handles stay with the original.
+PluginCore::PluginCore(const PluginCore& other)
+    : mPath(other.mPath),
+      mArchive(other.mArchive),
+      mFlatMap(other.mFlatMap),
+      mDecoderMutex(other.mDecoderMutex),
+      mRoot(other.mRoot),
+      mCurrentDir(other.mCurrentDir),
+      mLastError(other.mLastError),
+      mResidency(MemoryGovernor::Instance().Register(MemoryGovernor::Priority::kArchives, [this] { Evict(); })) {}
+
+PluginCore::Call PluginCore::Enter() {
+  mResidency.Touch();
+  return Call(*this);
+}
+
+void PluginCore::Evict() {
+  // Never waits: the governor may be reclaiming on behalf of a call into this very plugin, on another thread. The
+  // lock is recursive, so it is also taken when that call runs on this thread (e.g. the memory verb lowering the
+  // budget); the call depth tells that case apart.
+  std::unique_lock lock(mCallMutex, std::try_to_lock);
+  if (!lock || mCallDepth || mOpenHandles || !mArchive)
+    return;
+
+  // The memory is only released once no clone or in-flight open shares the archive.
+  mPath.clear();
+  mArchive.reset();
+  mFlatMap.reset();
+  mDecoderMutex.reset();
+  mRoot.reset();
+  mCurrentDir = nullptr;
+}
+
+void PluginCore::SetError(int error) {
+  mLastError = error;
+#ifdef _WIN32
+  ::SetLastError(error);
+#endif
+}
+
+// --- Initialization & Archive Info ---
+
+std::optional<std::filesystem::path> PluginCore::LoadFile(std::filesystem::path path) {
+  path = sanitize(std::move(path));
+  SetError(0);
+
+  if (!mPath.empty() && is_subpath(mPath, path)) {
+    // Path is already loaded, no need to check again. Both paths are normalized, so no filesystem access is needed to
+    // relate them.
+    return path.lexically_relative(mPath);
+  }
+
+  // Loading new file. Should we cache this?
+  mPath.clear();
+  mArchive.reset();
+
+  SetError(ERROR_FILE_NOT_FOUND);
+
+  // Hosts probe many unrelated paths in a row; the cache answers repeats without touching the filesystem.
+  auto& roots = ArchiveRootCache::Instance();
+  std::filesystem::path real_file_path;
+  if (auto cached = roots.Find(path)) {
+    if (cached->empty())
+      return {};
+    real_file_path = std::move(*cached);
+  } else {
+    // Walk the path up until we find an existing file or directory.
+    real_file_path = path;
+    std::filesystem::path missing;
+    std::filesystem::file_status status;
+    while (!real_file_path.empty()) {
+      std::error_code error;
+      status = std::filesystem::status(real_file_path, error);
+      if (std::filesystem::exists(status))
+        break;
+      missing = real_file_path;
+      real_file_path = real_file_path.parent_path();
+    }
+
+    if (real_file_path.empty() || !is_archive_name(real_file_path.native())) {
+      // Nothing below a missing directory or a plain file can be in an archive. An existing directory only rules
+      // out itself: archives may be added to it.
+      if (!missing.empty())
+        roots.AddNone(missing, /* subtree= */ true);
+      else if (!real_file_path.empty())
+        roots.AddNone(real_file_path, /* subtree= */ !std::filesystem::is_directory(status));
+      return {};
+    }
+  }
+
+  // The open runs in the background; wait for it, but give up as soon as the caller aborts. The open itself carries
+  // on, and the next request for the same archive picks it up.
+  auto pending = ArchiveLoader::Open(real_file_path);
+  while (pending.wait_for(std::chrono::milliseconds(50)) != std::future_status::ready) {
+    if (ShouldAbort()) {
+      SetError(ERROR_CANCELLED);
+      return {};
+    }
+  }
+
+  auto opened = pending.get();
+  if (!opened) {
+    roots.Forget(real_file_path);
+    return {};
+  }
+  roots.AddArchive(real_file_path);
+
+  SetError(0);
+  mArchive = opened->archive_;
+  mFlatMap = opened->entries_;
+  mDecoderMutex = opened->decoder_mutex_;
+  mPath = real_file_path;
+  ReconstructDirStructure();
+  return path.lexically_relative(mPath);
+}
+
+// --- File I/O ---
+
+PluginFile* PluginCore::OpenFile(ArchivePath path, bool for_writing) {
+  if (for_writing)
+    return {};
+
+  auto* node = FindEntry(path);
+  if (!node || !node->file_)
+    return {};
+
+  auto result = new PluginFile();
+  result->file_ = std::shared_ptr<LzxEntry>(mFlatMap, node->file_);
+  result->decoder_mutex_ = mDecoderMutex;
+  ++mOpenHandles;
+  return result;
+}
+
+bool PluginCore::ReadFile(PluginFile* file, std::span<uint8_t> buffer, size_t* read_size) {
+  SetError(0);
+  *read_size = 0;
+
+  if (file->offset_ >= file->file_->unpack_size())
+    return false;
+
+  // Locate segment to read from. Reads only move forward, so the search resumes at the segment of the previous read
+  // rather than at the start of the entry.
+  size_t segment_size{};
+  size_t segment_index{file->segment_index_};
+
+  auto segment_iter = std::ranges::next(file->file_->segments().begin(), segment_index);
+  for (; segment_iter != file->file_->segments().end(); ++segment_iter, ++segment_index) {
+    segment_size = segment_iter->decompressed_length();
+    // Locate first segment that has any relevant data.
+    if (file->offset_ - file->segment_start_ < segment_size)
+      break;
+
+    file->segment_start_ += segment_size;
+  }
+  file->segment_index_ = segment_index;
+
+  if (segment_iter == file->file_->segments().end())
+    return false;
+
+  size_t read_offset{file->offset_ - file->segment_start_};
+
+  // Reads only ever move forward, so once an entry spans several segments, decode the next ones in the background
+  // while the caller consumes the current one.
+  if (!file->prefetcher_ && std::next(segment_iter) != file->file_->segments().end())
+    file->prefetcher_ = std::make_unique<SegmentPrefetcher>(*file->file_, segment_index, file->decoder_mutex_);
+
+  // Without a prefetcher, decode in place; the data is only valid while the decoder lock is held.
+  std::unique_lock<std::mutex> decoding;
+  std::span<const uint8_t> data;
+  if (file->prefetcher_) {
+    data = file->prefetcher_->Get(segment_index);
+  } else {
+    decoding = std::unique_lock(*file->decoder_mutex_);
+    data = segment_iter->data();
+  }
+  // A damaged stream may decode to less than the header promised.
+  if (data.size() <= read_offset) {
+    SetError(ERROR_READ_FAULT);
+    return false;
+  }
+
+  auto chunk = data.subspan(read_offset, std::min(std::min(segment_size, data.size()) - read_offset, buffer.size()));
+  std::ranges::copy(chunk, buffer.begin());
+  file->crc_ = crc32_update(file->crc_, chunk);
+  file->offset_ += chunk.size();
+
+  if (file->offset_ == file->file_->unpack_size() && file->crc_ != file->file_->crc()) {
+    SetError(ERROR_CRC);
+    return false;
+  }
+
+  *read_size = chunk.size();
+
+  return true;
+}
+
+void PluginCore::CloseFile(PluginFile* file) {
+  if (file)
+    --mOpenHandles;
+  delete file;
+}
+
+// --- Extraction ---
+
+bool PluginCore::DecodeEntry(LzxEntry& entry, const std::filesystem::path& name, ExtractSink& sink) {
+  if (sink.Reuse(name, entry.unpack_size(), entry.crc()))
+    return true;
+
+  if (!sink.Begin(name, entry.unpack_size())) {
+    SetError(ERROR_WRITE_FAULT);
+    return false;
+  }
+
+  uint32_t crc{};
+  for (auto& segment : entry.segments()) {
+    std::lock_guard decoding(*mDecoderMutex);
+    auto data = segment.data();
+
+    // Decompress failure.
+    if (segment.status() != Status::Ok)
+      break;
+
+    crc = crc32_update(crc, data);
+
+    // Write failure.
+    if (!sink.Write(data)) {
+      sink.End(false);
+      SetError(ERROR_WRITE_FAULT);
+      return false;
+    }
+  }
+
+  // Also catches decompression failures, which leave the output short.
+  bool verified = crc == entry.crc();
+  if (!sink.End(verified)) {
+    SetError(ERROR_WRITE_FAULT);
+    return false;
+  }
+  if (!verified) {
+    SetError(ERROR_CRC);
+    return false;
+  }
+  return true;
+}
+
+bool PluginCore::ExtractTo(std::filesystem::path source_path, ExtractSink& sink) {
+  source_path = sanitize(std::move(source_path));
+  auto* node = FindEntry(ArchivePath(source_path));
+  if (!node)
+    return false;
+
+  // Entries of the whole archive are named relative to its root.
+  auto base = node == mRoot.get() ? std::filesystem::path() : source_path.filename();
+  bool success = true;
+  for (auto& [name, entry] : CollectFiles(*node, std::move(base))) {
+    if (!DecodeEntry(*entry, name, sink))
+      success = false;
+  }
+  return success;
+}
+
+// --- Listing ---
+
+bool PluginCore::ListEntries(std::filesystem::path path, const ListCallback& on_entry) {
+  path = sanitize(std::move(path));
+  auto* node = FindEntry(ArchivePath(path));
+  if (!node)
+    return false;
+
+  auto base = node == mRoot.get() ? std::filesystem::path() : path.filename();
+  for (auto& [name, entry] : CollectFiles(*node, std::move(base))) {
+    if (!on_entry(name, *entry))
+      break;
+  }
+  return true;
+}
+
+// --- Content Search ---
+
+bool PluginCore::SearchContent(std::filesystem::path path,
+                               std::string_view needle,
+                               bool names_only,
+                               const SearchCallback& on_match) {
+  SetError(0);
+
+  path = sanitize(std::move(path));
+  auto relative = LoadFile(path);
+  if (!relative || !ChangeDir(ArchivePath(path))) {
+    SetError(ERROR_PATH_NOT_FOUND);
+    return false;
+  }
+  if (*relative == ".")
+    relative->clear();
+
+  // Collect the entries first; the callback is free to call back into the plugin and move mCurrentDir.
+  auto entries = CollectFiles(*mCurrentDir, *relative);
+
+  if (needle.empty() || entries.empty())
+    return true;
+
+  // Entries of a merge group decode from one compressed stream, so each group is searched as a whole, in archive order,
+  // on one decoder. Entries whose group is unknown are searched on their own.
+  std::unordered_map<const LzxEntry*, const std::string*> keys;
+  for (auto& [key, entry] : *mFlatMap)
+    keys.emplace(&entry, &key);
+  std::unordered_map<std::string_view, size_t> positions;
+  for (size_t index = 0; index < entries.size(); ++index)
+    positions.emplace(*keys.at(entries[index].second), index);
+
+  std::vector<std::vector<size_t>> groups;
+  if (entries.size() > 1) {
+    for (const auto& names : read_merge_groups(mPath).value_or(std::vector<std::vector<std::string>>{})) {
+      std::vector<size_t> group;
+      for (const auto& name : names) {
+        if (auto found = positions.find(name); found != positions.end()) {
+          group.push_back(found->second);
+          positions.erase(found);
+        }
+      }
+      if (!group.empty())
+        groups.push_back(std::move(group));
+    }
+  }
+  for (auto [name, index] : positions)
+    groups.push_back({index});
+
+  std::atomic<size_t> next{};
+  std::atomic<bool> stop{};
+  std::atomic<int> first_error{};
+  auto fail = [&](int error) {
+    int none = 0;
+    first_error.compare_exchange_strong(none, error);
+    stop = true;
+  };
+
+  // Matches are reported one at a time, in the order they are found.
+  std::mutex match_mutex;
+  auto report = [&](const std::filesystem::path& name, uint64_t offset) {
+    std::lock_guard lock(match_mutex);
+    if (stop)
+      return false;
+    if (!on_match(name, offset))
+      stop = true;
+    return !stop;
+  };
+
+  // The calling thread searches on the shared decoder. Other workers open a decoder of their own once they take a
+  // group, since each open reads all entry headers again and keeps another decoder in memory; without one, they share.
+  auto search = [&](bool shared) {
+    ContentMatcher matcher(needle);
+    std::shared_ptr<const ArchiveLoader::Archive> archive;
+    for (size_t group; !stop && (group = next++) < groups.size();) {
+      if (!shared && !archive)
+        shared = !(archive = ArchiveLoader::OpenPrivate(mPath));
+      for (size_t index : groups[group]) {
+        if (stop)
+          return;
+        auto& [name, entry] = entries[index];
+        LzxEntry* decoded = entry;
+        std::mutex* decoder_mutex = mDecoderMutex.get();
+        if (archive) {
+          auto found = archive->entries_->find(*keys.at(entry));
+          if (found == archive->entries_->end()) {
+            fail(ERROR_READ_FAULT);
+            return;
+          }
+          decoded = &found->second;
+          decoder_mutex = archive->decoder_mutex_.get();
+        }
+        if (int error = SearchEntry(name, *decoded, *decoder_mutex, matcher, names_only, report, stop))
+          fail(error);
+      }
+    }
+  };
+
+  size_t worker_count = std::min({size_t{std::max(1u, std::thread::hardware_concurrency())}, groups.size(),
+                                  kMaxSearchWorkers});
+  {
+    std::vector<std::jthread> workers;
+    for (size_t worker = 1; worker < worker_count; ++worker)
+      workers.emplace_back(search, false);
+    search(true);
+  }
+
+  if (first_error) {
+    SetError(first_error);
+    return false;
+  }
+  return true;
+}
+
+int PluginCore::SearchEntry(const std::filesystem::path& name,
+                            LzxEntry& entry,
+                            std::mutex& decoder_mutex,
+                            ContentMatcher& matcher,
+                            bool names_only,
+                            const SearchCallback& on_match,
+                            const std::atomic<bool>& stop) const {
+  matcher.Reset();
+  auto on_offset = [&](uint64_t offset) { return on_match(name, offset) && !names_only; };
+
+  for (auto& segment : entry.segments()) {
+    if (stop)
+      return 0;
+    if (ShouldAbort())
+      return ERROR_CANCELLED;
+
+    std::lock_guard decoding(decoder_mutex);
+    auto data = segment.data();
+    if (segment.status() != Status::Ok)
+      return ERROR_READ_FAULT;
+    if (!matcher.Feed(data, on_offset))
+      return 0;
+  }
+  return 0;
+}
@@ -0,0 +1,254 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "archive_path.hh"
+#include "content_matcher.hh"
+#include "extract_sink.hh"
+#include "memory_governor.hh"
+#include "segment_prefetcher.hh"
+#include "unlzx.hh"
+
+/// @brief Represents an open file within the archive.
+/// @details Owns the archive the file was opened from, so that it can still be read after the plugin loads another.
+struct PluginFile {
+  // Shares ownership of the archive's entry list, and thereby of the whole archive; see ArchiveLoader::Archive.
+  std::shared_ptr<LzxEntry> file_;
+  // Lock of the decoder `file_` belongs to.
+  std::shared_ptr<std::mutex> decoder_mutex_;
+  size_t offset_{};
+  // Segment holding `offset_`, and the offset in the entry at which that segment starts.
+  size_t segment_index_{};
+  size_t segment_start_{};
+  // CRC of the data read so far, verified once the whole entry has been read.
+  uint32_t crc_{};
+  // Decodes segments ahead of the reader; created on the first read of a multi-segment entry.
+  std::unique_ptr<SegmentPrefetcher> prefetcher_;
+};
+
+/// @brief Platform-independent part of the plugin: loads archives, resolves paths within them, and lists, extracts and
+/// searches their entries.
+/// @details Plugin adds the Directory Opus VFS interface on top; the extraction scheduler and `lzxtool` use the core
+/// directly, on any platform. Errors are reported as Win32 error codes (see system_errors.hh) through GetError().
+class PluginCore {
+ public:
+  struct DirEnt {
+    using allocator_type = std::pmr::polymorphic_allocator<>;
+
+    explicit DirEnt(allocator_type alloc = {}) : children_(alloc) {}
+    DirEnt(const DirEnt&) = delete;
+    DirEnt& operator=(const DirEnt&) = delete;
+
+    // Transparent comparator permits lookups by string_view. Children and their names share the node's allocator.
+    std::pmr::map<std::pmr::string, DirEnt, std::less<>> children_;
+    LzxEntry* file_{};
+  };
+
+  /// @brief Directory tree of a single archive.
+  /// @details All nodes and names are carved from one arena. Nodes are never destroyed individually; the whole tree is
+  /// released at once when the last reference to it goes away. The tree shares ownership of the entries its nodes point
+  /// to, and through them of the whole opened archive, so any reference to a node keeps the archive it came from.
+  struct DirTree {
+    /// @brief Creates an empty tree.
+    /// @param size_hint Expected number of entries, used to size the arena's first block.
+    explicit DirTree(size_t size_hint);
+
+    DirTree(const DirTree&) = delete;
+    DirTree& operator=(const DirTree&) = delete;
+
+    std::pmr::monotonic_buffer_resource arena_;
+    DirEnt* root_{};
+    std::shared_ptr<std::map<std::string, LzxEntry>> entries_;
+  };
+
+  /// @brief Callback receiving content search matches.
+  /// @details Invoked with the archive-relative name of the entry and the offset of the match within that entry.
+  /// Return false to stop the search.
+  using SearchCallback = std::function<bool(const std::filesystem::path& name, uint64_t offset)>;
+
+  /// @brief Callback receiving listed entries: the archive-relative name and the entry. Return false to stop.
+  using ListCallback = std::function<bool(const std::filesystem::path& name, const LzxEntry& entry)>;
+
+  /// @brief Scope of a call from outside the plugin; see Enter().
+  class [[nodiscard]] Call {
+   public:
+    explicit Call(PluginCore& plugin) : plugin_(&plugin), lock_(plugin.mCallMutex) { ++plugin.mCallDepth; }
+    Call(Call&& other) noexcept : plugin_(std::exchange(other.plugin_, nullptr)), lock_(std::move(other.lock_)) {}
+    Call& operator=(Call&&) = delete;
+
+    // Runs before `lock_` is released.
+    ~Call() {
+      if (plugin_)
+        --plugin_->mCallDepth;
+    }
+
+   private:
+    PluginCore* plugin_;
+    std::unique_lock<std::recursive_mutex> lock_;
+  };
+
+  PluginCore();
+  PluginCore(const PluginCore& other);
+  PluginCore& operator=(const PluginCore&) = delete;
+  virtual ~PluginCore() = default;
+
+  /// @brief Marks the start of a call from outside the plugin.
+  /// @details While the returned scope is alive, the memory governor leaves the plugin's archive loaded. Every caller
+  /// (the VFS exports, the extraction scheduler) holds it for the duration of each call. Calls may nest.
+  Call Enter();
+
+  /// @brief Loads an LZX archive from the specified path.
+  /// @details The archive is opened in the background (see ArchiveLoader). The call waits for it, returning early with
+  /// ERROR_CANCELLED once ShouldAbort() returns true.
+  /// @param path Path to the archive file, or to a file or directory within it.
+  /// @return The path relative to the archive if successful.
+  std::optional<std::filesystem::path> LoadFile(std::filesystem::path path);
+
+  /// @brief Returns the last error that occurred.
+  /// @return The last error code.
+  int GetError() const { return mLastError; }
+
+  /// @brief Opens a file within the archive.
+  /// @param path The path of the file to open.
+  /// @param for_writing true if opening for writing, which is not supported; false for reading.
+  /// @return The open file, to be closed with CloseFile(), or nullptr on failure.
+  PluginFile* OpenFile(ArchivePath path, bool for_writing);
+
+  /// @brief Reads the next part of an open file. Reads only move forward.
+  /// @param file The open file.
+  /// @param buffer Buffer to read data into.
+  /// @param read_size Receives the number of bytes read.
+  /// @return true if successful, false at the end of the file or on error (see GetError()).
+  bool ReadFile(PluginFile* file, std::span<uint8_t> buffer, size_t* read_size);
+
+  /// @brief Closes an open file.
+  /// @param file The file to close; may be nullptr.
+  void CloseFile(PluginFile* file);
+
+  /// @brief Extracts a file or folder from the archive into a sink.
+  /// @details Entry names passed to the sink start with the name of `source_path` itself; for the archive itself, they
+  /// are relative to its root.
+  /// @param source_path Path within the archive to extract, or the archive itself.
+  /// @param sink Destination for the decoded data.
+  /// @return true if every entry was extracted successfully, false otherwise.
+  bool ExtractTo(std::filesystem::path source_path, ExtractSink& sink);
+
+  /// @brief Lists all files at or below a path, in name order.
+  /// @details Names are formed as for ExtractTo: they start with the name of `path` itself; for the archive itself,
+  /// they are relative to its root.
+  /// @param path File or directory path within an archive, or the archive itself.
+  /// @param on_entry Callback invoked for every file.
+  /// @return false if the path was not found.
+  bool ListEntries(std::filesystem::path path, const ListCallback& on_entry);
+
+  /// @brief Searches decompressed contents of all files at or below a path for a byte sequence.
+  /// @details Entries are streamed segment by segment through a ContentMatcher; nothing is extracted to disk. Matches
+  /// spanning segment boundaries are reported. Merge groups (see read_merge_groups) are searched in parallel, each as
+  /// a whole on one decoder, so that their shared stream is decoded once. Workers other than the calling thread open
+  /// a decoder of their own (see ArchiveLoader::OpenPrivate) when they take their first group. Matches within an entry
+  /// are reported in offset order, but matches of different entries may interleave. The callback is never invoked
+  /// concurrently; it runs under a decoder lock and must not read from the same archive.
+  /// @param path File or directory path to search.
+  /// @param needle Byte sequence to look for.
+  /// @param names_only true to stop decoding an entry at its first match (report each entry at most once).
+  /// @param on_match Callback invoked for every match.
+  /// @return true if the search completed (or was stopped by the callback), false on error or abort.
+  bool SearchContent(std::filesystem::path path,
+                     std::string_view needle,
+                     bool names_only,
+                     const SearchCallback& on_match);
+
+ protected:
+  /// @brief Checks if an abort has been requested. The core never aborts by itself.
+  /// @details SearchContent calls it from several threads at once.
+  virtual bool ShouldAbort() const { return false; }
+
+  /// @brief Sets the last error code.
+  /// @param error The error code to set.
+  void SetError(int error);
+
+  /// @brief Rebuilds mRoot from the entries of the current archive in mFlatMap.
+  void ReconstructDirStructure();
+
+  /// @brief Lists all files at or below a node of the tree, in name order.
+  /// @param dir The node to start at.
+  /// @param name Name to give the starting node; names of the files below are built from it.
+  /// @return The files with their names.
+  std::vector<std::pair<std::filesystem::path, LzxEntry*>> CollectFiles(const DirEnt& dir, std::filesystem::path name);
+
+  /// @brief Navigate to a specific (absolute) path within the archive.
+  /// @param dir The absolute path to navigate to.
+  /// @return true if successful, false otherwise.
+  bool ChangeDir(ArchivePath dir);
+
+  /// @brief Locates the tree node for an (absolute) path, loading the archive if needed.
+  /// @details Paths within the loaded archive are resolved in place, without allocating.
+  /// @param path The absolute path to look up.
+  /// @return The node (the root node for the archive itself), or nullptr if not found.
+  DirEnt* FindEntry(ArchivePath path);
+
+  /// @brief Decodes a single entry into a sink, verifying its CRC.
+  /// @details Holds the decoder lock while the sink consumes each segment, so the sink must not decode from the same
+  /// archive.
+  /// @param entry The entry to decode.
+  /// @param name Name of the entry passed to the sink.
+  /// @param sink Destination for the decoded data.
+  /// @return true if the entry was decoded, verified and written in full.
+  bool DecodeEntry(LzxEntry& entry, const std::filesystem::path& name, ExtractSink& sink);
+
+  std::filesystem::path mPath;
+  std::shared_ptr<Unlzx> mArchive;
+  std::shared_ptr<std::map<std::string, LzxEntry>> mFlatMap;
+  // Held while decoding any entry of mArchive and using the decoded data; see ArchiveLoader::Archive.
+  std::shared_ptr<std::mutex> mDecoderMutex;
+  // Aliases the root node of the owning DirTree.
+  std::shared_ptr<DirEnt> mRoot;
+  DirEnt* mCurrentDir{};
+  int mLastError{};
+  // Open files and enumerations. Each shares ownership of the archive and tree it points into, so it stays valid when
+  // another archive is loaded. While any is open, Evict() leaves the archive loaded, as dropping it would free nothing.
+  size_t mOpenHandles{};
+
+ private:
+  /// @brief Drops the loaded archive to give memory back to the governor; it is reloaded on next use.
+  /// @details Does nothing while a call is in progress, on any thread including the calling one, or handles are open.
+  void Evict();
+
+  /// @brief Streams a single entry through the content matcher.
+  /// @details Safe to run on several threads at once, each with its own matcher and decoder.
+  /// @param name Archive-relative name of the entry, passed to the callback.
+  /// @param entry The entry to search.
+  /// @param decoder_mutex Lock of the decoder `entry` belongs to.
+  /// @param matcher Matcher for the needle; reset for the entry.
+  /// @param names_only true to stop at the first match.
+  /// @param on_match Callback invoked for every match.
+  /// @param stop Set once the search should stop; checked between segments.
+  /// @return 0 if the entry was searched or the search stopped, otherwise the error that ended it.
+  int SearchEntry(const std::filesystem::path& name,
+                  LzxEntry& entry,
+                  std::mutex& decoder_mutex,
+                  ContentMatcher& matcher,
+                  bool names_only,
+                  const SearchCallback& on_match,
+                  const std::atomic<bool>& stop) const;
+
+  // Held for the duration of every call from outside the plugin; see Enter().
+  std::recursive_mutex mCallMutex;
+  // Calls in progress on the thread holding mCallMutex; guarded by it.
+  size_t mCallDepth{};
+  // Declared last, so that it unregisters before the state Evict() touches is destroyed.
+  MemoryGovernor::Registration mResidency;
+};
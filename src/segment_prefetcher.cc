@@ -0,0 +1,88 @@
+#include "segment_prefetcher.hh"
+
+#include <algorithm>
+#include <iterator>
+#include <ranges>
+
+#include "memory_governor.hh"
+
+SegmentPrefetcher::SegmentPrefetcher(LzxEntry& entry, size_t first_segment, std::shared_ptr<std::mutex> decoder_mutex)
+    : entry_(entry),
+      segment_count_(std::ranges::distance(entry.segments())),
+      decoder_mutex_(std::move(decoder_mutex)),
+      next_to_decode_(first_segment),
+      current_index_(first_segment),
+      last_request_(Clock::now()),
+      worker_([this](std::stop_token stop) { Run(std::move(stop)); }) {}
+
+std::span<const uint8_t> SegmentPrefetcher::Get(size_t index) {
+  std::unique_lock lock(mutex_);
+  if (has_current_ && index == current_index_)
+    return current_.span();
+
+  // Keep about as many segments in flight as are decoded in the time the reader spends on one.
+  auto now = Clock::now();
+  auto consume_time = std::max(now - last_request_, Clock::duration(1));
+  last_request_ = now;
+  depth_ = std::clamp<size_t>((decode_time_ + consume_time - Clock::duration(1)) / consume_time, 1, kMaxDepth);
+  // Read-ahead is optional; under memory pressure, decode only the next segment.
+  if (depth_ > 1 && !MemoryGovernor::Instance().HasRoom(current_.size() * (depth_ - 1)))
+    depth_ = 1;
+
+  current_index_ = index;
+  has_current_ = false;
+  for (auto& slot : slots_) {
+    if (slot.filled_ && slot.index_ < index) {
+      slot.filled_ = false;
+      slot.buffer_ = {};
+    }
+  }
+  changed_.notify_all();
+
+  // A segment the worker already passed, without it being ready, was dropped; report it as failed.
+  changed_.wait(lock, [this, index] { return IsReady(index) || next_to_decode_ > index; });
+  current_ = {};
+  if (IsReady(index)) {
+    auto& slot = SlotOf(index);
+    slot.filled_ = false;
+    current_ = std::move(slot.buffer_);
+  }
+  has_current_ = true;
+  changed_.notify_all();
+  return current_.span();
+}
+
+void SegmentPrefetcher::Run(std::stop_token stop) {
+  while (true) {
+    size_t index;
+    {
+      std::unique_lock lock(mutex_);
+      bool wake = changed_.wait(lock, stop, [this] {
+        return next_to_decode_ < segment_count_ && next_to_decode_ <= current_index_ + depth_;
+      });
+      if (!wake)
+        return;
+      index = next_to_decode_;
+    }
+
+    auto start = Clock::now();
+    BufferPool::Buffer buffer;
+    {
+      std::lock_guard decoding(*decoder_mutex_);
+      auto& segment = *std::ranges::next(entry_.segments().begin(), index);
+      auto data = segment.data();
+      if (segment.status() == Status::Ok)
+        buffer = BufferPool::Instance().Copy(data);
+    }
+    auto elapsed = Clock::now() - start;
+
+    std::lock_guard lock(mutex_);
+    auto& slot = SlotOf(index);
+    slot.index_ = index;
+    slot.filled_ = true;
+    slot.buffer_ = std::move(buffer);
+    decode_time_ = elapsed;
+    ++next_to_decode_;
+    changed_.notify_all();
+  }
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+
+#include "buffer_pool.hh"
+#include "unlzx.hh"
+
+/// @brief Decodes the segments of an entry ahead of a sequential reader, on a worker thread.
+/// @details While the reader consumes one segment, the worker decodes the following ones into buffers owned by the
+/// prefetcher. The number of segments kept ahead follows the ratio of decode time to the time the reader spends on
+/// each segment, between 1 and `kMaxDepth`. The worker decodes under the archive's decoder lock, like every other user
+/// of the decoder, and copies the data out before releasing it. Buffers come from `BufferPool` and decoded segments
+/// wait in a fixed ring, so that reading allocates nothing once the pool is warm. While the `MemoryGovernor` budget is
+/// exhausted, only one segment is kept ahead. Destroying the prefetcher waits for an in-flight decode and returns all
+/// buffers to the pool.
+class SegmentPrefetcher {
+ public:
+  /// @brief Maximum number of segments decoded ahead of the reader.
+  static constexpr size_t kMaxDepth = 4;
+
+  /// @brief Starts decoding the entry's segments, beginning at `first_segment`.
+  /// @param entry The entry to decode. Must outlive the prefetcher.
+  /// @param first_segment Index of the first segment the reader will request.
+  /// @param decoder_mutex Lock of the archive's decoder; see `ArchiveLoader::Archive`.
+  SegmentPrefetcher(LzxEntry& entry, size_t first_segment, std::shared_ptr<std::mutex> decoder_mutex);
+
+  SegmentPrefetcher(const SegmentPrefetcher&) = delete;
+  SegmentPrefetcher& operator=(const SegmentPrefetcher&) = delete;
+
+  /// @brief Returns decoded data of a segment, waiting for the worker if it is not ready yet.
+  /// @details Segments must be requested in non-decreasing order. Buffers of earlier segments are released.
+  /// @param index Index of the segment.
+  /// @return Decoded data, valid until the next call requesting a different segment; empty on decode failure.
+  std::span<const uint8_t> Get(size_t index);
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  /// @brief Worker thread body.
+  void Run(std::stop_token stop);
+
+  LzxEntry& entry_;
+  const size_t segment_count_;
+  std::shared_ptr<std::mutex> decoder_mutex_;
+
+  std::mutex mutex_;
+  std::condition_variable_any changed_;
+  /// @brief Decoded segment not yet handed to the reader. An empty buffer marks a decode failure.
+  struct Slot {
+    size_t index_;
+    bool filled_{};
+    BufferPool::Buffer buffer_;
+  };
+
+  /// @brief Returns the ring slot of a segment. Ready segments lie within `kMaxDepth` of the reader's, so they never
+  /// share a slot.
+  Slot& SlotOf(size_t index) { return slots_[index % slots_.size()]; }
+
+  /// @brief Returns true if the segment was decoded and not yet handed to the reader.
+  bool IsReady(size_t index) { return SlotOf(index).filled_ && SlotOf(index).index_ == index; }
+
+  std::array<Slot, kMaxDepth + 1> slots_;
+  // Next segment the worker will decode.
+  size_t next_to_decode_;
+  // Segment the reader currently holds.
+  size_t current_index_;
+  BufferPool::Buffer current_;
+  bool has_current_{};
+  size_t depth_{1};
+  Clock::duration decode_time_{};
+  Clock::time_point last_request_{};
+
+  // Declared last so that it is joined before the state above is destroyed.
+  std::jthread worker_;
+};
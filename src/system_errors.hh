@@ -0,0 +1,18 @@
+#pragma once
+
+/// @brief Win32 error codes reported by the plugin core, on every platform.
+/// @details On Windows they come from windows.h, and errors set by the core also reach the host through SetLastError.
+/// Elsewhere only the codes the core reports are defined, with the same values, so that callers such as `lzxtool` see
+/// the same numbers everywhere.
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+constexpr int ERROR_FILE_NOT_FOUND = 2;
+constexpr int ERROR_PATH_NOT_FOUND = 3;
+constexpr int ERROR_CRC = 23;
+constexpr int ERROR_WRITE_FAULT = 29;
+constexpr int ERROR_READ_FAULT = 30;
+constexpr int ERROR_NOT_SUPPORTED = 50;
+constexpr int ERROR_CANCELLED = 1223;
+#endif
@@ -1,56 +1,311 @@
 #include "text_utils.hh"
 
+#ifdef _WIN32
 #include <windows.h>
+#endif
 
-std::wstring latin1_to_wstring(std::string_view latin1) {
-  int wide_len = MultiByteToWideChar(28591,  // ISO-8859-1 code page
-                                     /* flags= */ 0, latin1.data(), static_cast<int>(latin1.size()), nullptr, 0);
+#include <algorithm>
+#include <bit>
+#include <cstdint>
 
-  std::wstring wide(wide_len, 0);
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TEXT_UTILS_SSE2 1
+#endif
 
-  MultiByteToWideChar(28591, 0, latin1.data(), static_cast<int>(latin1.size()), &wide[0], wide_len);
+namespace {
 
-  // Truncate the null terminator added by MultiByteToWideChar
-  if (!wide.empty() && wide.back() == L'\0') {
-    wide.pop_back();
+/// @brief Returns the length of the leading run of 7-bit characters in `str`.
+size_t ascii_prefix_length(std::string_view str) {
+  size_t pos = 0;
+#ifdef TEXT_UTILS_SSE2
+  for (; pos + 16 <= str.size(); pos += 16) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str.data() + pos));
+    // Top bit of every byte; any set bit marks a non-ASCII character.
+    auto mask = static_cast<unsigned>(_mm_movemask_epi8(chunk));
+    if (mask)
+      return pos + std::countr_zero(mask);
   }
+#endif
+  while (pos < str.size() && !(static_cast<uint8_t>(str[pos]) & 0x80))
+    ++pos;
+  return pos;
+}
 
-  return wide;
+/// @brief Zero-extends every byte of `in` into a wide character. Correct for both ASCII and Latin-1 input.
+void widen(const char* in, size_t size, wchar_t* out) {
+  size_t pos = 0;
+#ifdef TEXT_UTILS_SSE2
+  const __m128i zero = _mm_setzero_si128();
+  for (; pos + 16 <= size; pos += 16) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + pos));
+    __m128i lo = _mm_unpacklo_epi8(chunk, zero);
+    __m128i hi = _mm_unpackhi_epi8(chunk, zero);
+    auto* dest = reinterpret_cast<__m128i*>(out + pos);
+    if constexpr (sizeof(wchar_t) == 2) {
+      _mm_storeu_si128(dest, lo);
+      _mm_storeu_si128(dest + 1, hi);
+    } else {
+      _mm_storeu_si128(dest, _mm_unpacklo_epi16(lo, zero));
+      _mm_storeu_si128(dest + 1, _mm_unpackhi_epi16(lo, zero));
+      _mm_storeu_si128(dest + 2, _mm_unpacklo_epi16(hi, zero));
+      _mm_storeu_si128(dest + 3, _mm_unpackhi_epi16(hi, zero));
+    }
+  }
+#endif
+  for (; pos < size; ++pos)
+    out[pos] = static_cast<uint8_t>(in[pos]);
 }
 
-std::wstring utf8_to_wstring(std::string_view utf8) {
-    if (utf8.empty()) return {};
+/// @brief Narrows the leading run of wide characters that fit in Latin-1.
+/// @return Number of characters narrowed.
+size_t narrow_latin1_prefix(const wchar_t* in, size_t size, char* out) {
+  size_t pos = 0;
+#ifdef TEXT_UTILS_SSE2
+  if constexpr (sizeof(wchar_t) == 2) {
+    const __m128i high_byte = _mm_set1_epi16(static_cast<short>(0xff00));
+    const __m128i zero = _mm_setzero_si128();
+    for (; pos + 16 <= size; pos += 16) {
+      __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + pos));
+      __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + pos + 8));
+      __m128i overflow = _mm_and_si128(_mm_or_si128(lo, hi), high_byte);
+      if (_mm_movemask_epi8(_mm_cmpeq_epi8(overflow, zero)) != 0xffff)
+        break;
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + pos), _mm_packus_epi16(lo, hi));
+    }
+  }
+#endif
+  for (; pos < size && static_cast<uint32_t>(in[pos]) <= 0xff; ++pos)
+    out[pos] = static_cast<char>(in[pos]);
+  return pos;
+}
 
-    int size = MultiByteToWideChar(
-        CP_UTF8, 0,
-        utf8.data(), utf8.size(),
-        nullptr, 0);
+#ifndef _WIN32
+/// @brief Portable UTF-8 decoder used where the Win32 converter is not available.
+/// @details Invalid sequences decode to U+FFFD. Code points outside the BMP become surrogate pairs when `wchar_t` is
+/// 16 bits wide. Stops when `out` is full.
+/// @return Number of wide characters written.
+size_t decode_utf8(std::string_view utf8, std::span<wchar_t> out) {
+  size_t written = 0;
+  size_t pos = 0;
+  while (pos < utf8.size() && written < out.size()) {
+    auto lead = static_cast<uint8_t>(utf8[pos++]);
+    uint32_t code_point = 0xfffd;
+    int trail = lead >= 0xf0 ? 3 : lead >= 0xe0 ? 2 : lead >= 0xc0 ? 1 : 0;
+    if (lead < 0x80) {
+      code_point = lead;
+    } else if (trail && lead < 0xf5 && pos + trail <= utf8.size()) {
+      uint32_t value = lead & (0x3f >> trail);
+      int consumed = 0;
+      for (; consumed < trail && (static_cast<uint8_t>(utf8[pos + consumed]) & 0xc0) == 0x80; ++consumed)
+        value = (value << 6) | (static_cast<uint8_t>(utf8[pos + consumed]) & 0x3f);
+      pos += consumed;
+      if (consumed == trail)
+        code_point = value;
+    }
 
-    std::wstring result(size, 0);
+    if (sizeof(wchar_t) == 2 && code_point > 0xffff) {
+      if (written + 2 > out.size())
+        break;
+      code_point -= 0x10000;
+      out[written++] = static_cast<wchar_t>(0xd800 + (code_point >> 10));
+      out[written++] = static_cast<wchar_t>(0xdc00 + (code_point & 0x3ff));
+    } else {
+      out[written++] = static_cast<wchar_t>(code_point);
+    }
+  }
+  return written;
+}
 
-    MultiByteToWideChar(
-        CP_UTF8, 0,
-        utf8.data(), utf8.size(),
-        result.data(), size);
+/// @brief Portable UTF-8 encoder used where the Win32 converter is not available.
+/// @details Unpaired surrogates encode as U+FFFD. Never splits a character; stops when `out` is full.
+/// @return Number of bytes written.
+size_t encode_utf8(std::wstring_view wide, std::span<char> out) {
+  size_t written = 0;
+  for (size_t pos = 0; pos < wide.size(); ++pos) {
+    auto code_point = static_cast<uint32_t>(wide[pos]);
+    if (code_point >= 0xd800 && code_point < 0xe000) {
+      bool paired = code_point < 0xdc00 && pos + 1 < wide.size() && static_cast<uint32_t>(wide[pos + 1]) >= 0xdc00 &&
+                    static_cast<uint32_t>(wide[pos + 1]) < 0xe000;
+      if (paired) {
+        code_point = 0x10000 + ((code_point - 0xd800) << 10) + (static_cast<uint32_t>(wide[++pos]) - 0xdc00);
+      } else {
+        code_point = 0xfffd;
+      }
+    }
+    if (code_point > 0x10ffff)
+      code_point = 0xfffd;
 
-    return result;
+    size_t length = code_point < 0x80 ? 1 : code_point < 0x800 ? 2 : code_point < 0x10000 ? 3 : 4;
+    if (written + length > out.size())
+      break;
+
+    if (length == 1) {
+      out[written++] = static_cast<char>(code_point);
+      continue;
+    }
+    static constexpr uint8_t kLeadBits[] = {0, 0, 0xc0, 0xe0, 0xf0};
+    for (size_t byte = length - 1; byte > 0; --byte) {
+      out[written + byte] = static_cast<char>(0x80 | (code_point & 0x3f));
+      code_point >>= 6;
+    }
+    out[written] = static_cast<char>(kLeadBits[length] | code_point);
+    written += length;
+  }
+  return written;
 }
+#endif
 
-std::string wstring_to_latin1(std::wstring_view wide) {
-  int latin1_len =
-      WideCharToMultiByte(28591,  // ISO-8859-1 code page
-                          WC_NO_BEST_FIT_CHARS, wide.data(), static_cast<int>(wide.size()), nullptr, 0, "?", nullptr);
+}  // namespace
+
+size_t latin1_to_wide(std::string_view latin1, std::span<wchar_t> out) {
+  if (out.empty())
+    return 0;
+
+  size_t length = std::min(latin1.size(), out.size() - 1);
+  widen(latin1.data(), length, out.data());
+  out[length] = L'\0';
+  return length;
+}
+
+size_t utf8_to_wide(std::string_view utf8, std::span<wchar_t> out) {
+  if (out.empty())
+    return 0;
+
+  // Amiga names are almost always plain ASCII. Widen that part directly and hand only the remainder to the general
+  // converter; the prefix always ends on a character boundary.
+  size_t capacity = out.size() - 1;
+  size_t ascii = std::min(ascii_prefix_length(utf8), capacity);
+  widen(utf8.data(), ascii, out.data());
+
+  size_t length = ascii;
+  auto rest = utf8.substr(ascii);
+  if (!rest.empty() && ascii < capacity) {
+#ifdef _WIN32
+    int converted = MultiByteToWideChar(CP_UTF8, 0, rest.data(), static_cast<int>(rest.size()), out.data() + ascii,
+                                        static_cast<int>(capacity - ascii));
+    if (converted == 0) {
+      // Does not fit; convert in full and truncate.
+      auto wide = utf8_to_wstring(rest);
+      converted = static_cast<int>(std::min(wide.size(), capacity - ascii));
+      std::copy_n(wide.begin(), converted, out.begin() + ascii);
+    }
+    length += converted;
+#else
+    length += decode_utf8(rest, out.subspan(ascii, capacity - ascii));
+#endif
+  }
+
+  out[length] = L'\0';
+  return length;
+}
+
+size_t wide_to_latin1(std::wstring_view wide, std::span<char> out) {
+  if (out.empty())
+    return 0;
+
+  size_t capacity = out.size() - 1;
+  size_t length = narrow_latin1_prefix(wide.data(), std::min(wide.size(), capacity), out.data());
+
+  // Anything left either did not fit or has no Latin-1 representation; substitute the latter.
+  for (size_t pos = length; pos < wide.size() && length < capacity; ++pos) {
+    auto ch = static_cast<uint32_t>(wide[pos]);
+    // A surrogate pair stands for a single character.
+    if (ch >= 0xdc00 && ch < 0xe000 && pos > 0 && static_cast<uint32_t>(wide[pos - 1]) >= 0xd800 &&
+        static_cast<uint32_t>(wide[pos - 1]) < 0xdc00)
+      continue;
+    out[length++] = ch <= 0xff ? static_cast<char>(ch) : '?';
+  }
+
+  out[length] = '\0';
+  return length;
+}
+
+size_t wide_to_utf8(std::wstring_view wide, std::span<char> out) {
+  if (out.empty())
+    return 0;
 
-  std::string latin1(latin1_len, 0);
+  size_t capacity = out.size() - 1;
+  size_t length = 0;
+  for (; length < wide.size() && length < capacity && static_cast<uint32_t>(wide[length]) < 0x80; ++length)
+    out[length] = static_cast<char>(wide[length]);
 
-  WideCharToMultiByte(28591, WC_NO_BEST_FIT_CHARS, wide.data(), static_cast<int>(wide.size()), &latin1[0], latin1_len,
-                      "?", nullptr);
+  auto rest = wide.substr(length);
+  if (!rest.empty() && length < capacity) {
+#ifdef _WIN32
+    // Fails outright if the output does not fit; the result is then truncated to the ASCII part.
+    length += WideCharToMultiByte(CP_UTF8, 0, rest.data(), static_cast<int>(rest.size()), out.data() + length,
+                                  static_cast<int>(capacity - length), nullptr, nullptr);
+#else
+    length += encode_utf8(rest, out.subspan(length, capacity - length));
+#endif
+  }
+
+  out[length] = '\0';
+  return length;
+}
+
+size_t native_to_utf8(std::basic_string_view<std::filesystem::path::value_type> native, std::span<char> out) {
+#ifdef _WIN32
+  return wide_to_utf8(native, out);
+#else
+  if (out.empty())
+    return 0;
 
-  // Truncate the null terminator added by WideCharToMultiByte
-  if (!latin1.empty() && latin1.back() == '\0') {
-    latin1.pop_back();
+  // Back up to the start of a character if the copy must be cut short.
+  size_t length = std::min(native.size(), out.size() - 1);
+  if (length < native.size()) {
+    while (length > 0 && (static_cast<uint8_t>(native[length]) & 0xc0) == 0x80)
+      --length;
   }
+  std::copy_n(native.begin(), length, out.begin());
+  out[length] = '\0';
+  return length;
+#endif
+}
+
+std::filesystem::path utf8_to_path(std::string_view utf8) {
+#ifdef _WIN32
+  return utf8_to_wstring(utf8);
+#else
+  return std::filesystem::path(utf8);
+#endif
+}
+
+std::wstring latin1_to_wstring(std::string_view latin1) {
+  std::wstring wide;
+  wide.resize_and_overwrite(latin1.size(), [latin1](wchar_t* buffer, size_t size) {
+    widen(latin1.data(), size, buffer);
+    return size;
+  });
+  return wide;
+}
+
+std::wstring utf8_to_wstring(std::string_view utf8) {
+  if (ascii_prefix_length(utf8) == utf8.size())
+    return latin1_to_wstring(utf8);
+
+  std::wstring result;
+#ifdef _WIN32
+  int length = MultiByteToWideChar(CP_UTF8, 0, utf8.data(), static_cast<int>(utf8.size()), nullptr, 0);
+  result.resize_and_overwrite(length, [utf8](wchar_t* buffer, size_t size) {
+    return MultiByteToWideChar(CP_UTF8, 0, utf8.data(), static_cast<int>(utf8.size()), buffer, static_cast<int>(size));
+  });
+#else
+  // A UTF-8 sequence never decodes to more wide characters than it has bytes.
+  result.resize_and_overwrite(utf8.size(), [utf8](wchar_t* buffer, size_t size) {
+    return decode_utf8(utf8, std::span<wchar_t>(buffer, size));
+  });
+#endif
+  return result;
+}
 
+std::string wstring_to_latin1(std::wstring_view wide) {
+  std::string latin1;
+  // The buffer passed to the operation has room for the terminator that wide_to_latin1 appends.
+  latin1.resize_and_overwrite(wide.size(), [wide](char* buffer, size_t size) {
+    return wide_to_latin1(wide, std::span<char>(buffer, size + 1));
+  });
   return latin1;
 }
 
@@ -68,3 +323,60 @@ bool is_subpath(const std::filesystem::path& base, const std::filesystem::path&
 
   return std::mismatch(b.begin(), b.end(), n.begin(), n.end()).first == b.end();
 }
+
+bool is_archive_name(std::basic_string_view<std::filesystem::path::value_type> name) {
+  constexpr std::string_view kExtension = ".lzx";
+  if (name.size() <= kExtension.size())
+    return false;
+
+  auto extension = name.substr(name.size() - kExtension.size());
+  return std::ranges::equal(extension, kExtension, [](auto a, char b) {
+    return (a >= 'A' && a <= 'Z' ? a - 'A' + 'a' : a) == b;
+  });
+}
+
+bool has_wildcards(std::string_view pattern) {
+  return pattern.find_first_of("*?") != std::string_view::npos;
+}
+
+bool wildcard_match(std::string_view pattern, std::string_view name) {
+  if (pattern == "*" || pattern == "*.*")
+    return true;
+
+  // Skip a complete UTF-8 sequence, so that `?` never splits a multi-byte character.
+  auto next_char = [](std::string_view str, size_t pos) {
+    ++pos;
+    while (pos < str.size() && (static_cast<uint8_t>(str[pos]) & 0xc0) == 0x80)
+      ++pos;
+    return pos;
+  };
+
+  size_t p = 0;
+  size_t n = 0;
+  // Position of the last `*` seen and the name position it is currently matched up to.
+  size_t star_p = std::string_view::npos;
+  size_t star_n = 0;
+
+  while (n < name.size()) {
+    if (p < pattern.size() && pattern[p] == '*') {
+      star_p = p++;
+      star_n = n;
+    } else if (p < pattern.size() && pattern[p] == '?') {
+      ++p;
+      n = next_char(name, n);
+    } else if (p < pattern.size() && pattern[p] == name[n]) {
+      ++p;
+      ++n;
+    } else if (star_p != std::string_view::npos) {
+      // Backtrack: let the last `*` swallow one more character.
+      p = star_p + 1;
+      n = star_n = next_char(name, star_n);
+    } else {
+      return false;
+    }
+  }
+
+  while (p < pattern.size() && pattern[p] == '*')
+    ++p;
+  return p == pattern.size();
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <filesystem>
+#include <span>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -20,6 +21,50 @@ std::wstring utf8_to_wstring(std::string_view utf8);
 /// @return latin1 encoded string
 std::string wstring_to_latin1(std::wstring_view wide);
 
+/// @brief Convert a latin1 string to wide characters in a caller-provided buffer, without allocating.
+/// @details The output is always NUL-terminated and truncated if it does not fit.
+/// @param latin1 Input string in latin1 encoding
+/// @param out Output buffer, e.g. `WIN32_FIND_DATAW::cFileName`.
+/// @return Number of wide characters written, excluding the NUL terminator.
+size_t latin1_to_wide(std::string_view latin1, std::span<wchar_t> out);
+
+/// @brief Convert an utf8 string to wide characters in a caller-provided buffer.
+/// @details ASCII input is widened directly; only multibyte sequences go through the general converter. The output is
+/// always NUL-terminated and truncated if it does not fit.
+/// @param utf8 Input string in utf8 encoding
+/// @param out Output buffer, e.g. `WIN32_FIND_DATAW::cFileName`.
+/// @return Number of wide characters written, excluding the NUL terminator.
+size_t utf8_to_wide(std::string_view utf8, std::span<wchar_t> out);
+
+/// @brief Convert a wide string to latin1 in a caller-provided buffer.
+/// @details Characters with no latin1 representation are replaced with `?`. The output is always NUL-terminated and
+/// truncated if it does not fit.
+/// @param wide Input string in wide character encoding (UTF-16 on Windows)
+/// @param out Output buffer.
+/// @return Number of characters written, excluding the NUL terminator.
+size_t wide_to_latin1(std::wstring_view wide, std::span<char> out);
+
+/// @brief Convert a wide string to utf8 in a caller-provided buffer.
+/// @details ASCII input is narrowed directly; only other characters go through the general converter. The output is
+/// always NUL-terminated and truncated if it does not fit.
+/// @param wide Input string in wide character encoding (UTF-16 on Windows)
+/// @param out Output buffer.
+/// @return Number of bytes written, excluding the NUL terminator.
+size_t wide_to_utf8(std::wstring_view wide, std::span<char> out);
+
+/// @brief Convert a native path string to utf8 in a caller-provided buffer.
+/// @details Native paths are UTF-16 on Windows and taken to be UTF-8 elsewhere. The output is always NUL-terminated
+/// and truncated if it does not fit, never within a character.
+/// @param native Input string in the platform's path encoding.
+/// @param out Output buffer.
+/// @return Number of bytes written, excluding the NUL terminator.
+size_t native_to_utf8(std::basic_string_view<std::filesystem::path::value_type> native, std::span<char> out);
+
+/// @brief Convert an utf8 name to a path, in the platform's path encoding.
+/// @param utf8 Input string in utf8 encoding
+/// @return The path.
+std::filesystem::path utf8_to_path(std::string_view utf8);
+
 /// @brief Clean up input paths ensuring that it always contains the "filename" stem, even if pointing to a directory.
 /// @param in The path to sanitize.
 /// @return sanitized path.
@@ -29,3 +74,19 @@ std::filesystem::path sanitize(std::filesystem::path in);
 /// @param base The base path (e.g. namespace).
 /// @param node The node path to check.
 bool is_subpath(const std::filesystem::path& base, const std::filesystem::path& node);
+
+/// @brief Returns whether a file name carries an extension handled by the plugin (`.lzx`, in any case).
+/// @param name The file name or path to check.
+bool is_archive_name(std::basic_string_view<std::filesystem::path::value_type> name);
+
+/// @brief Returns whether the pattern contains any of the `*` or `?` wildcard characters.
+/// @param pattern The pattern to check.
+bool has_wildcards(std::string_view pattern);
+
+/// @brief Matches a name against a DOS-style wildcard pattern (`*` and `?`).
+/// @details Matching is case-sensitive, in line with the plugin's declared capabilities. `?` consumes a single UTF-8
+/// encoded character. The `*` and `*.*` patterns match every name.
+/// @param pattern The wildcard pattern.
+/// @param name The name to match.
+/// @return true if `name` matches the `pattern`.
+bool wildcard_match(std::string_view pattern, std::string_view name);
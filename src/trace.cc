@@ -0,0 +1,191 @@
+#include "trace.hh"
+
+#ifdef PLUGIN_TRACE
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cwchar>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "buffer_pool.hh"
+#include "text_utils.hh"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Event {
+  const char* name_;
+  uint64_t plugin_;
+  uint64_t start_;
+  uint64_t duration_;
+  uint64_t handle_;
+  uint64_t size_;
+  uint64_t result_;
+  uint32_t path_size_;
+  bool truncated_;
+  char path_[TraceScope::kMaxPath];
+};
+
+/// @brief Events of one thread. Written only by the owning thread; read by `trace_flush`.
+struct ThreadBuffer {
+  static constexpr size_t kCapacity = 4096;
+
+  std::array<Event, kCapacity> events_;
+  // Number of events ever recorded; the slot of event `n` is `n % kCapacity`.
+  std::atomic<uint64_t> count_{};
+  uint64_t thread_id_{};
+};
+
+struct Registry {
+  std::mutex mutex_;
+  std::vector<std::unique_ptr<ThreadBuffer>> buffers_;
+};
+
+/// @brief Returns the buffers of all threads that recorded events.
+/// @details Never destroyed, so that buffers outlive any thread still recording while the plugin unloads.
+Registry& registry() {
+  static auto* registry = new Registry();
+  return *registry;
+}
+
+/// @brief Returns the calling thread's buffer, registering it on first use. Only registration takes the lock.
+ThreadBuffer& thread_buffer() {
+  thread_local ThreadBuffer* buffer = [] {
+    auto& all = registry();
+    std::lock_guard lock(all.mutex_);
+    auto& created = all.buffers_.emplace_back(std::make_unique<ThreadBuffer>());
+    created->thread_id_ = std::hash<std::thread::id>()(std::this_thread::get_id());
+    return created.get();
+  }();
+  return *buffer;
+}
+
+uint64_t now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+/// @brief Writes `text` as the contents of a JSON string.
+void write_json_string(std::FILE* file, std::string_view text) {
+  for (char c : text) {
+    if (c == '"' || c == '\\')
+      std::fprintf(file, "\\%c", c);
+    else if (static_cast<unsigned char>(c) < 0x20)
+      std::fprintf(file, "\\u%04x", c);
+    else
+      std::fputc(c, file);
+  }
+}
+
+/// @brief Returns the length of `wide` in UTF-8 bytes.
+size_t utf8_size(std::wstring_view wide) {
+  size_t size = 0;
+  for (wchar_t c : wide) {
+    auto code = static_cast<uint32_t>(c);
+    // Each half of a UTF-16 surrogate pair accounts for two of the four bytes of its character.
+    if (code < 0x80)
+      size += 1;
+    else if (code < 0x800 || (code >= 0xd800 && code < 0xe000))
+      size += 2;
+    else
+      size += code < 0x10000 ? 3 : 4;
+  }
+  return size;
+}
+
+std::filesystem::path trace_file_path() {
+  if (const char* name = std::getenv("OPUSLZX_TRACE"); name && *name)
+    return name;
+
+  std::error_code error;
+  return std::filesystem::temp_directory_path(error) / "opuslzx-trace.json";
+}
+
+}  // namespace
+
+TraceScope::TraceScope(const char* name, const void* plugin, const wchar_t* path)
+    : name_(name), plugin_(reinterpret_cast<uintptr_t>(plugin)) {
+  if (path) {
+    // Converted before the clock starts, so that tracing does not inflate the call's duration.
+    std::wstring_view wide(path, std::wcslen(path));
+    path_size_ = wide_to_utf8(wide, path_);
+    truncated_ = path_size_ < utf8_size(wide);
+  }
+  start_ = now();
+}
+
+TraceScope::~TraceScope() {
+  auto end = now();
+  auto& buffer = thread_buffer();
+  auto index = buffer.count_.load(std::memory_order_relaxed);
+
+  auto& event = buffer.events_[index % ThreadBuffer::kCapacity];
+  event.name_ = name_;
+  event.plugin_ = plugin_;
+  event.start_ = start_;
+  event.duration_ = end - start_;
+  event.handle_ = handle_;
+  event.size_ = size_;
+  event.result_ = result_;
+  event.path_size_ = path_size_;
+  event.truncated_ = truncated_;
+  std::copy_n(path_, path_size_, event.path_);
+
+  buffer.count_.store(index + 1, std::memory_order_release);
+}
+
+void trace_flush() {
+  auto path = trace_file_path();
+#ifdef _WIN32
+  std::FILE* file = _wfopen(path.c_str(), L"w");
+#else
+  std::FILE* file = std::fopen(path.c_str(), "w");
+#endif
+  if (!file)
+    return;
+
+  auto& all = registry();
+  std::lock_guard lock(all.mutex_);
+
+  std::fprintf(file, "{\"traceEvents\":[\n");
+  bool first = true;
+  for (const auto& buffer : all.buffers_) {
+    auto count = buffer->count_.load(std::memory_order_acquire);
+    auto oldest = count > ThreadBuffer::kCapacity ? count - ThreadBuffer::kCapacity : 0;
+    for (auto index = oldest; index < count; ++index) {
+      const auto& event = buffer->events_[index % ThreadBuffer::kCapacity];
+      std::fprintf(file,
+                   "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%llu,\"ts\":%.3f,\"dur\":%.3f,\"args\":{"
+                   "\"plugin\":%llu,\"handle\":%llu,\"size\":%llu,\"result\":%llu,\"path\":\"",
+                   first ? "" : ",\n", event.name_, static_cast<unsigned long long>(buffer->thread_id_),
+                   event.start_ / 1000.0, event.duration_ / 1000.0, static_cast<unsigned long long>(event.plugin_),
+                   static_cast<unsigned long long>(event.handle_), static_cast<unsigned long long>(event.size_),
+                   static_cast<unsigned long long>(event.result_));
+      write_json_string(file, std::string_view(event.path_, event.path_size_));
+      std::fprintf(file, event.truncated_ ? "\",\"truncated\":1}}" : "\"}}");
+      first = false;
+    }
+  }
+
+  // Pool counters at the time of the flush; allocations staying flat across a replay show a steady state.
+  auto stats = BufferPool::Instance().GetStats();
+  std::fprintf(file,
+               "%s{\"name\":\"BufferPool\",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,\"args\":{\"allocations\":%llu,"
+               "\"reuses\":%llu,\"outstanding\":%llu,\"idle_bytes\":%llu}}",
+               first ? "" : ",\n", now() / 1000.0, static_cast<unsigned long long>(stats.allocations_),
+               static_cast<unsigned long long>(stats.reuses_), static_cast<unsigned long long>(stats.outstanding_),
+               static_cast<unsigned long long>(stats.idle_bytes_));
+  std::fprintf(file, "\n]}\n");
+  std::fclose(file);
+}
+
+#endif
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+/// @brief Records the VFS calls made by the host, with their arguments and timing.
+/// @details Built in only with PLUGIN_TRACE defined (the OPUSLZX_TRACE CMake option); otherwise TraceScope is an empty
+/// class and every use of it compiles away.
+///
+/// Each thread records into its own fixed-size ring buffer, without locks; once full, the oldest events are
+/// overwritten. `trace_flush` writes all buffers as a Chrome trace (chrome://tracing, Perfetto), one event per line, to
+/// the file named by the OPUSLZX_TRACE environment variable, or to opuslzx-trace.json in the temporary directory.
+/// Besides the timing, every event records the plugin instance, the file or find handle, the path, a size and the
+/// result, which is enough to replay the sequence of calls. Paths too long to record are cut short and the event is
+/// marked as truncated.
+
+#ifdef PLUGIN_TRACE
+
+/// @brief Records a single call: the call's name and arguments at construction, its duration at destruction.
+class TraceScope {
+ public:
+  /// @brief Size of the recorded path, in UTF-8 bytes including a NUL terminator; longer paths are truncated.
+  static constexpr size_t kMaxPath = 192;
+
+  /// @param name Name of the call. Must be a string literal.
+  /// @param plugin The plugin instance the call is made on.
+  /// @param path Path argument of the call, if any.
+  TraceScope(const char* name, const void* plugin, const wchar_t* path = nullptr);
+  ~TraceScope();
+
+  TraceScope(const TraceScope&) = delete;
+  TraceScope& operator=(const TraceScope&) = delete;
+
+  /// @brief Records the file or find handle the call operates on.
+  void Handle(const void* handle) { handle_ = reinterpret_cast<uintptr_t>(handle); }
+
+  /// @brief Records the size argument of the call, e.g. the number of bytes to read or of files to extract.
+  void Size(uint64_t size) { size_ = size; }
+
+  /// @brief Records the result of the call and passes it through.
+  template <typename T>
+  T Result(T result) {
+    if constexpr (std::is_pointer_v<T>)
+      result_ = reinterpret_cast<uintptr_t>(result);
+    else
+      result_ = static_cast<uint64_t>(result);
+    return result;
+  }
+
+ private:
+  const char* name_;
+  uint64_t plugin_;
+  uint64_t start_;
+  uint64_t handle_{};
+  uint64_t size_{};
+  uint64_t result_{};
+  uint32_t path_size_{};
+  bool truncated_{};
+  char path_[kMaxPath];
+};
+
+/// @brief Writes all recorded events to the trace file.
+void trace_flush();
+
+#else
+
+class TraceScope {
+ public:
+  TraceScope(const char*, const void*, const wchar_t* = nullptr) {}
+  void Handle(const void*) {}
+  void Size(uint64_t) {}
+  template <typename T>
+  T Result(T result) {
+    return result;
+  }
+};
+
+inline void trace_flush() {}
+
+#endif
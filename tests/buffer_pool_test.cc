@@ -0,0 +1,85 @@
+#include "buffer_pool.hh"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+class BufferPoolTest : public testing::Test {
+ protected:
+  // Each test starts from empty free lists, whatever ran before it in the process.
+  void SetUp() override { pool_.Trim(); }
+  void TearDown() override { pool_.Trim(); }
+
+  BufferPool& pool_ = BufferPool::Instance();
+};
+
+TEST_F(BufferPoolTest, ReleasedBlockIsHandedOutAgain) {
+  auto before = pool_.GetStats();
+  uint8_t* data = nullptr;
+  {
+    auto buffer = pool_.Acquire(10000);
+    ASSERT_TRUE(buffer);
+    EXPECT_EQ(buffer.size(), 10000u);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(buffer.data()) % BufferPool::kAlignment, 0u);
+    data = buffer.data();
+  }
+  EXPECT_EQ(pool_.GetStats().idle_bytes_, 16384u);
+
+  // Same size class, 16 KiB.
+  auto buffer = pool_.Acquire(12000);
+  EXPECT_EQ(buffer.data(), data);
+  auto after = pool_.GetStats();
+  EXPECT_EQ(after.allocations_ - before.allocations_, 1u);
+  EXPECT_EQ(after.reuses_ - before.reuses_, 1u);
+  EXPECT_EQ(after.outstanding_ - before.outstanding_, 1u);
+  EXPECT_EQ(after.idle_bytes_, 0u);
+}
+
+TEST_F(BufferPoolTest, SteadyStateTakesNoBlocksFromTheSystem) {
+  // Segments of varying sizes, a few of them in flight at once, as a prefetching reader holds them.
+  const std::vector<size_t> sizes = {4096, 5000, 65536, 70000, 1 << 20};
+  auto round = [&] {
+    std::vector<BufferPool::Buffer> buffers;
+    for (size_t size : sizes)
+      buffers.push_back(pool_.Acquire(size));
+    for (const auto& buffer : buffers)
+      ASSERT_TRUE(buffer);
+  };
+
+  round();
+  auto warm = pool_.GetStats();
+  for (int i = 0; i < 100; ++i)
+    round();
+
+  auto after = pool_.GetStats();
+  EXPECT_EQ(after.allocations_, warm.allocations_);
+  EXPECT_EQ(after.reuses_ - warm.reuses_, 100 * sizes.size());
+  EXPECT_EQ(after.outstanding_, warm.outstanding_);
+  EXPECT_EQ(after.idle_bytes_, warm.idle_bytes_);
+}
+
+TEST_F(BufferPoolTest, FreeListsAreBounded) {
+  std::vector<BufferPool::Buffer> buffers;
+  for (size_t i = 0; i < BufferPool::kMaxFreePerClass + 2; ++i)
+    buffers.push_back(pool_.Acquire(4096));
+  buffers.clear();
+
+  EXPECT_EQ(pool_.GetStats().idle_bytes_, BufferPool::kMaxFreePerClass * 4096);
+}
+
+TEST_F(BufferPoolTest, TrimReturnsIdleBlocks) {
+  pool_.Acquire(4096);
+  EXPECT_NE(pool_.GetStats().idle_bytes_, 0u);
+
+  auto before = pool_.GetStats();
+  pool_.Trim();
+  EXPECT_EQ(pool_.GetStats().idle_bytes_, 0u);
+
+  pool_.Acquire(4096);
+  EXPECT_EQ(pool_.GetStats().allocations_ - before.allocations_, 1u);
+}
+
+}  // namespace
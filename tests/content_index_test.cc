@@ -0,0 +1,177 @@
+#include "content_index.hh"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <span>
+#include <string_view>
+
+#include "sink_test_util.hh"
+
+namespace {
+
+class ContentIndexTest : public SinkTest {};
+
+TEST_F(ContentIndexTest, LoadKeepsNamesVerbatim) {
+  WriteFile(root_ / ContentIndex::kFileName, "5 0000abcd  leading spaces.txt\n3 00000001 plain\n");
+  auto index = ContentIndex::Load(root_);
+  ASSERT_TRUE(index);
+
+  auto found = index->Find(5, 0xabcd);
+  ASSERT_EQ(found.size(), 1u);
+  EXPECT_EQ(found[0], root_ / " leading spaces.txt");
+  ASSERT_EQ(index->Find(3, 1).size(), 1u);
+  EXPECT_EQ(index->Find(3, 1)[0], root_ / "plain");
+}
+
+TEST_F(ContentIndexTest, SaveRoundTrips) {
+  WriteFile(root_ / ContentIndex::kFileName, "");
+  auto index = ContentIndex::Load(root_);
+  ASSERT_TRUE(index);
+  index->Add(7, 0x1234, root_ / "  two spaces");
+  index->Add(8, 0x5678, root_ / "dir" / "file");
+  ASSERT_TRUE(index->Save());
+
+  auto reloaded = ContentIndex::Load(root_);
+  ASSERT_TRUE(reloaded);
+  ASSERT_EQ(reloaded->Find(7, 0x1234).size(), 1u);
+  EXPECT_EQ(reloaded->Find(7, 0x1234)[0], root_ / "  two spaces");
+  ASSERT_EQ(reloaded->Find(8, 0x5678).size(), 1u);
+  EXPECT_EQ(reloaded->Find(8, 0x5678)[0], root_ / "dir/file");
+}
+
+TEST_F(ContentIndexTest, LinksIdenticalContent) {
+  WriteFile(root_ / ContentIndex::kFileName, "");
+  auto index = ContentIndex::Load(root_);
+  ASSERT_TRUE(index);
+  constexpr std::string_view kContent = "duplicated content";
+
+  DedupFileSink sink(root_, *index);
+  ASSERT_EQ(Extract(sink, "first", kContent), Extracted::kWritten);
+  ASSERT_EQ(Extract(sink, "second", kContent), Extracted::kWritten);
+
+  EXPECT_EQ(ReadFile(root_ / "second"), kContent);
+  EXPECT_TRUE(std::filesystem::equivalent(root_ / "first", root_ / "second"));
+}
+
+TEST_F(ContentIndexTest, WritesNothingWhileDataMatches) {
+  WriteFile(root_ / ContentIndex::kFileName, "");
+  auto index = ContentIndex::Load(root_);
+  ASSERT_TRUE(index);
+  constexpr std::string_view kContent = "duplicated content";
+  WriteFile(root_ / "existing", kContent);
+  index->Add(kContent.size(), Crc(kContent), root_ / "existing");
+
+  DedupFileSink sink(root_, *index);
+  auto data = std::span(reinterpret_cast<const uint8_t*>(kContent.data()), kContent.size());
+  ASSERT_FALSE(sink.Reuse("entry", kContent.size(), Crc(kContent)));
+  ASSERT_TRUE(sink.Begin("entry", kContent.size()));
+  ASSERT_TRUE(sink.Write(data.first(5)));
+  ASSERT_TRUE(sink.Write(data.subspan(5)));
+  EXPECT_FALSE(std::filesystem::exists(root_ / "entry"));
+  ASSERT_TRUE(sink.End(true));
+
+  EXPECT_TRUE(std::filesystem::equivalent(root_ / "existing", root_ / "entry"));
+}
+
+TEST_F(ContentIndexTest, CopiesMatchedPartOnMismatch) {
+  WriteFile(root_ / ContentIndex::kFileName, "");
+  auto index = ContentIndex::Load(root_);
+  ASSERT_TRUE(index);
+  // Modified since it was indexed: same size, and the CRC the index still records, but the second half differs.
+  constexpr std::string_view kExisting = "same first half, other second";
+  constexpr std::string_view kEntry = "same first half, new one here";
+  ASSERT_EQ(kExisting.size(), kEntry.size());
+  WriteFile(root_ / "existing", kExisting);
+  index->Add(kEntry.size(), Crc(kEntry), root_ / "existing");
+
+  DedupFileSink sink(root_, *index);
+  ASSERT_EQ(Extract(sink, "entry", kEntry), Extracted::kWritten);
+
+  EXPECT_EQ(ReadFile(root_ / "entry"), kEntry);
+  EXPECT_EQ(ReadFile(root_ / "existing"), kExisting);
+  EXPECT_FALSE(std::filesystem::equivalent(root_ / "existing", root_ / "entry"));
+}
+
+TEST_F(ContentIndexTest, KeepsPartialEntryOnDecodeFailure) {
+  WriteFile(root_ / ContentIndex::kFileName, "");
+  auto index = ContentIndex::Load(root_);
+  ASSERT_TRUE(index);
+  constexpr std::string_view kContent = "duplicated content";
+  WriteFile(root_ / "existing", kContent);
+  index->Add(kContent.size(), Crc(kContent), root_ / "existing");
+
+  DedupFileSink sink(root_, *index);
+  ASSERT_FALSE(sink.Reuse("entry", kContent.size(), Crc(kContent)));
+  ASSERT_TRUE(sink.Begin("entry", kContent.size()));
+  ASSERT_TRUE(sink.Write(std::span(reinterpret_cast<const uint8_t*>(kContent.data()), 10)));
+  sink.End(false);
+
+  // The decoded part is written out, as by FileSink, and never linked.
+  EXPECT_EQ(ReadFile(root_ / "entry"), kContent.substr(0, 10));
+  EXPECT_FALSE(std::filesystem::equivalent(root_ / "existing", root_ / "entry"));
+}
+
+TEST_F(ContentIndexTest, DoesNotLinkOnCrcCollision) {
+  WriteFile(root_ / ContentIndex::kFileName, "");
+  auto index = ContentIndex::Load(root_);
+  ASSERT_TRUE(index);
+  // A well-known pair of strings with the same size and CRC-32.
+  constexpr std::string_view kExisting = "plumless";
+  constexpr std::string_view kEntry = "buckeroo";
+  ASSERT_EQ(Crc(kExisting), Crc(kEntry));
+  WriteFile(root_ / "existing", kExisting);
+  index->Add(kExisting.size(), Crc(kExisting), root_ / "existing");
+
+  DedupFileSink sink(root_, *index);
+  ASSERT_EQ(Extract(sink, "entry", kEntry), Extracted::kWritten);
+
+  EXPECT_EQ(ReadFile(root_ / "entry"), kEntry);
+  EXPECT_EQ(ReadFile(root_ / "existing"), kExisting);
+  EXPECT_FALSE(std::filesystem::equivalent(root_ / "existing", root_ / "entry"));
+}
+
+TEST_F(ContentIndexTest, RewritingALinkLeavesOtherLinksIntact) {
+  WriteFile(root_ / ContentIndex::kFileName, "");
+  auto index = ContentIndex::Load(root_);
+  ASSERT_TRUE(index);
+  constexpr std::string_view kContent = "shared content";
+  constexpr std::string_view kChanged = "changed content, longer";
+
+  DedupFileSink sink(root_, *index);
+  ASSERT_EQ(Extract(sink, "original", kContent), Extracted::kWritten);
+  ASSERT_EQ(Extract(sink, "copy", kContent), Extracted::kWritten);
+  ASSERT_TRUE(std::filesystem::equivalent(root_ / "original", root_ / "copy"));
+
+  FileSink plain(root_);
+  ASSERT_EQ(Extract(plain, "copy", kChanged), Extracted::kWritten);
+
+  EXPECT_EQ(ReadFile(root_ / "copy"), kChanged);
+  EXPECT_EQ(ReadFile(root_ / "original"), kContent);
+}
+
+TEST_F(ContentIndexTest, SyncLinksOnlyToFilesWithTheSyncTime) {
+  WriteFile(root_ / ContentIndex::kFileName, "");
+  auto index = ContentIndex::Load(root_);
+  ASSERT_TRUE(index);
+  constexpr std::string_view kContent = "synced content";
+  auto sync_time = std::filesystem::file_time_type::clock::now() - std::chrono::hours(24);
+  WriteFile(root_ / "unsynced", kContent);
+  index->Add(kContent.size(), Crc(kContent), root_ / "unsynced");
+
+  {
+    DedupFileSink sink(root_, *index, sync_time);
+    ASSERT_EQ(Extract(sink, "first", kContent), Extracted::kWritten);
+    ASSERT_EQ(Extract(sink, "second", kContent), Extracted::kWritten);
+  }
+  EXPECT_FALSE(std::filesystem::equivalent(root_ / "unsynced", root_ / "first"));
+  EXPECT_TRUE(std::filesystem::equivalent(root_ / "first", root_ / "second"));
+
+  // Another sync keeps both, the linked one included, rather than writing them again.
+  DedupFileSink sink(root_, *index, sync_time);
+  EXPECT_TRUE(sink.Reuse("first", kContent.size(), Crc(kContent)));
+  EXPECT_TRUE(sink.Reuse("second", kContent.size(), Crc(kContent)));
+  EXPECT_NE(std::filesystem::last_write_time(root_ / "unsynced"), sync_time);
+}
+
+}  // namespace
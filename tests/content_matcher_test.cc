@@ -0,0 +1,69 @@
+#include "content_matcher.hh"
+
+#include <gtest/gtest.h>
+
+#include <initializer_list>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+/// @brief Feeds `pieces` as one stream and returns the offsets of all matches.
+std::vector<uint64_t> Find(ContentMatcher& matcher, std::initializer_list<std::string_view> pieces) {
+  std::vector<uint64_t> offsets;
+  matcher.Reset();
+  for (auto piece : pieces) {
+    auto data = std::span(reinterpret_cast<const uint8_t*>(piece.data()), piece.size());
+    EXPECT_TRUE(matcher.Feed(data, [&](uint64_t offset) {
+      offsets.push_back(offset);
+      return true;
+    }));
+  }
+  return offsets;
+}
+
+TEST(ContentMatcherTest, FindsMatchesWithinPieces) {
+  ContentMatcher matcher("needle");
+  EXPECT_EQ(Find(matcher, {"a needle here", "and needle there"}), (std::vector<uint64_t>{2, 17}));
+}
+
+TEST(ContentMatcherTest, FindsMatchSpanningPieceBoundary) {
+  ContentMatcher matcher("needle");
+  EXPECT_EQ(Find(matcher, {"hay nee", "dle hay"}), std::vector<uint64_t>{4});
+  EXPECT_EQ(Find(matcher, {"hay needl", "e"}), std::vector<uint64_t>{4});
+  EXPECT_EQ(Find(matcher, {"n", "eedle"}), std::vector<uint64_t>{0});
+}
+
+TEST(ContentMatcherTest, FindsMatchSpanningShortMiddlePiece) {
+  ContentMatcher matcher("needle");
+  EXPECT_EQ(Find(matcher, {"hay ne", "ed", "le hay"}), std::vector<uint64_t>{4});
+  EXPECT_EQ(Find(matcher, {"n", "e", "e", "d", "l", "e"}), std::vector<uint64_t>{0});
+  // Empty pieces leave the carry alone.
+  EXPECT_EQ(Find(matcher, {"nee", "", "dle"}), std::vector<uint64_t>{0});
+}
+
+TEST(ContentMatcherTest, ReportsOverlappingMatchesOnce) {
+  ContentMatcher matcher("aaa");
+  EXPECT_EQ(Find(matcher, {"aaaaa"}), (std::vector<uint64_t>{0, 1, 2}));
+  EXPECT_EQ(Find(matcher, {"aa", "aa", "a"}), (std::vector<uint64_t>{0, 1, 2}));
+  EXPECT_EQ(Find(matcher, {"a", "a", "a", "a", "a"}), (std::vector<uint64_t>{0, 1, 2}));
+}
+
+TEST(ContentMatcherTest, ResetStartsNewStream) {
+  ContentMatcher matcher("needle");
+  EXPECT_TRUE(Find(matcher, {"hay nee"}).empty());
+  // Nothing of the previous stream is carried into the next one.
+  EXPECT_TRUE(Find(matcher, {"dle"}).empty());
+}
+
+TEST(ContentMatcherTest, CallbackStopsSearch) {
+  ContentMatcher matcher("x");
+  constexpr std::string_view kData = "x x x";
+  auto data = std::span(reinterpret_cast<const uint8_t*>(kData.data()), kData.size());
+  size_t calls{};
+  EXPECT_FALSE(matcher.Feed(data, [&](uint64_t offset) { return ++calls < 2; }));
+  EXPECT_EQ(calls, 2u);
+}
+
+}  // namespace
@@ -0,0 +1,104 @@
+#include "crc32.hh"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#ifdef OPUSLZX_TEST_ZLIB
+#include <zlib.h>
+#endif
+
+namespace {
+
+/// @brief Bit-at-a-time reference implementation.
+uint32_t reference_crc32(std::span<const uint8_t> data) {
+  uint32_t crc = ~0u;
+  for (uint8_t byte : data) {
+    crc ^= byte;
+    for (int bit = 0; bit < 8; ++bit)
+      crc = (crc >> 1) ^ (0xedb88320 & (0 - (crc & 1)));
+  }
+  return ~crc;
+}
+
+/// @brief Deterministic, non-repeating test data.
+std::vector<uint8_t> make_data(size_t size) {
+  std::vector<uint8_t> data(size);
+  uint32_t state = 0x12345678;
+  for (auto& byte : data) {
+    state = state * 1664525 + 1013904223;
+    byte = static_cast<uint8_t>(state >> 24);
+  }
+  return data;
+}
+
+TEST(Crc32Test, CheckValue) {
+  constexpr std::string_view kCheck = "123456789";
+  auto data = std::span(reinterpret_cast<const uint8_t*>(kCheck.data()), kCheck.size());
+  EXPECT_EQ(crc32_update(0, data), 0xcbf43926u);
+  EXPECT_EQ(crc32_update_portable(0, data), 0xcbf43926u);
+  EXPECT_EQ(crc32_update(0, {}), 0u);
+}
+
+TEST(Crc32Test, MatchesReferenceForAllSmallLengths) {
+  // Covers every remainder around the 16- and 64-byte blocks of the accelerated kernel.
+  auto data = make_data(300);
+  for (size_t size = 0; size <= data.size(); ++size) {
+    auto piece = std::span(data).first(size);
+    SCOPED_TRACE(size);
+    EXPECT_EQ(crc32_update(0, piece), reference_crc32(piece));
+  }
+}
+
+TEST(Crc32Test, SplitUpdatesMatchOneUpdate) {
+  auto data = make_data(1000);
+  auto expected = crc32_update(0, data);
+  for (size_t split : {1u, 15u, 16u, 63u, 64u, 65u, 500u, 999u}) {
+    SCOPED_TRACE(split);
+    auto span = std::span(data);
+    EXPECT_EQ(crc32_update(crc32_update(0, span.first(split)), span.subspan(split)), expected);
+  }
+
+  // Many uneven pieces.
+  uint32_t crc = 0;
+  for (size_t pos = 0, piece = 1; pos < data.size(); pos += piece, piece = piece * 3 % 97 + 1)
+    crc = crc32_update(crc, std::span(data).subspan(pos, std::min(piece, data.size() - pos)));
+  EXPECT_EQ(crc, expected);
+}
+
+TEST(Crc32Test, AcceleratedKernelMatchesPortable) {
+  // Unaligned starts and lengths well past the four-lane loop.
+  auto data = make_data(64 * 1024 + 67);
+  for (size_t offset : {0u, 1u, 3u, 8u}) {
+    for (size_t size : {64u, 80u, 127u, 128u, 129u, 4096u, 64u * 1024}) {
+      SCOPED_TRACE(testing::Message() << offset << "+" << size);
+      auto piece = std::span(data).subspan(offset, size);
+      EXPECT_EQ(crc32_update(0x9abcdef0, piece), crc32_update_portable(0x9abcdef0, piece));
+    }
+  }
+}
+
+#ifdef OPUSLZX_TEST_ZLIB
+TEST(Crc32Test, MatchesZlib) {
+  // Random lengths, offsets and running CRCs, fixed seed so that failures reproduce.
+  auto data = make_data(256 * 1024);
+  uint32_t state = 0x2545f491;
+  auto next = [&] { return state = state * 1664525 + 1013904223; };
+  for (int round = 0; round < 2000; ++round) {
+    size_t size = next() % (round < 1000 ? 512 : data.size());
+    size_t offset = next() % (data.size() - size + 1);
+    uint32_t crc = round % 2 ? next() : 0;
+    auto piece = std::span(data).subspan(offset, size);
+    SCOPED_TRACE(testing::Message() << offset << "+" << size << " from " << crc);
+    auto expected = static_cast<uint32_t>(::crc32(crc, piece.data(), static_cast<uInt>(piece.size())));
+    ASSERT_EQ(crc32_update(crc, piece), expected);
+    ASSERT_EQ(crc32_update_portable(crc, piece), expected);
+  }
+}
+#endif
+
+}  // namespace
@@ -0,0 +1,174 @@
+#include "extract_sink.hh"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <iterator>
+#include <cstdlib>
+#include <span>
+#include <sstream>
+#include <string>
+#include <string_view>
+
+#include "sink_test_util.hh"
+
+namespace {
+
+using namespace std::chrono_literals;
+
+class FileSinkTest : public SinkTest {
+ protected:
+  // Some time in the past, as an archive's modification time would be.
+  std::filesystem::file_time_type archive_time_ = std::filesystem::file_time_type::clock::now() - 24h;
+};
+
+TEST_F(FileSinkTest, WritesEveryEntryOutsideSyncMode) {
+  WriteFile(root_ / "file", "content");
+
+  FileSink sink(root_);
+  EXPECT_EQ(Extract(sink, "file", "content"), Extracted::kWritten);
+  EXPECT_EQ(ReadFile(root_ / "file"), "content");
+}
+
+TEST_F(FileSinkTest, SyncStampsAndThenKeepsUnchangedFiles) {
+  FileSink first(root_, archive_time_);
+  EXPECT_EQ(Extract(first, "file", "content"), Extracted::kWritten);
+  EXPECT_EQ(std::filesystem::last_write_time(root_ / "file"), archive_time_);
+
+  FileSink second(root_, archive_time_);
+  EXPECT_EQ(Extract(second, "file", "content"), Extracted::kReused);
+}
+
+TEST_F(FileSinkTest, SyncRewritesFilesWithAnotherTime) {
+  // Same size and content, but not written by a sync of this archive.
+  WriteFile(root_ / "file", "content");
+
+  FileSink sink(root_, archive_time_);
+  EXPECT_EQ(Extract(sink, "file", "content"), Extracted::kWritten);
+  EXPECT_EQ(std::filesystem::last_write_time(root_ / "file"), archive_time_);
+  // Finding out how the destination stores the time leaves nothing behind.
+  EXPECT_EQ(std::distance(std::filesystem::directory_iterator(root_), {}), 1);
+}
+
+TEST_F(FileSinkTest, SyncRewritesFilesWithOtherContent) {
+  // Modified in place and stamped back, so that only the CRC tells.
+  WriteFile(root_ / "file", "CONTENT");
+  std::filesystem::last_write_time(root_ / "file", archive_time_);
+
+  FileSink sink(root_, archive_time_);
+  EXPECT_EQ(Extract(sink, "file", "content"), Extracted::kWritten);
+  EXPECT_EQ(ReadFile(root_ / "file"), "content");
+}
+
+TEST_F(FileSinkTest, ZeroBlocksStraddlingWritesReadBackIdentically) {
+  constexpr size_t kBlock = FileSink::kHoleBlock;
+  std::string content = "head" + std::string(3 * kBlock, '\0') + "middle" + std::string(2 * kBlock, '\0') + "tail";
+
+  // Chunks that cut through every block, chunks that cover it exactly, and chunks larger than a block.
+  for (size_t chunk : {size_t{10000}, kBlock, kBlock + 1, content.size()}) {
+    SCOPED_TRACE(chunk);
+    FileSink sink(root_);
+    ASSERT_EQ(Extract(sink, "file", content, std::nullopt, chunk), Extracted::kWritten);
+    EXPECT_EQ(ReadFile(root_ / "file"), content);
+  }
+}
+
+TEST_F(FileSinkTest, UnalignedFirstBlockIsWritten) {
+  // Holes are aligned to the file offset: the zeros before the first boundary, and after the last, are data.
+  constexpr size_t kBlock = FileSink::kHoleBlock;
+  std::string content = std::string(100, 'x') + std::string(3 * kBlock, '\0') + "end";
+
+  FileSink sink(root_);
+  ASSERT_EQ(Extract(sink, "file", content, std::nullopt, content.size()), Extracted::kWritten);
+  EXPECT_EQ(ReadFile(root_ / "file"), content);
+}
+
+TEST_F(FileSinkTest, TrailingHoleKeepsTheFileSize) {
+  constexpr size_t kBlock = FileSink::kHoleBlock;
+  std::string content = std::string(kBlock, 'x') + std::string(2 * kBlock, '\0');
+
+  for (size_t chunk : {size_t{4096}, content.size()}) {
+    SCOPED_TRACE(chunk);
+    FileSink sink(root_);
+    ASSERT_EQ(Extract(sink, "file", content, std::nullopt, chunk), Extracted::kWritten);
+    EXPECT_EQ(std::filesystem::file_size(root_ / "file"), content.size());
+    EXPECT_EQ(ReadFile(root_ / "file"), content);
+  }
+
+  // Nothing but zeros.
+  FileSink sink(root_);
+  ASSERT_EQ(Extract(sink, "zeros", std::string(2 * kBlock, '\0'), std::nullopt, kBlock), Extracted::kWritten);
+  EXPECT_EQ(ReadFile(root_ / "zeros"), std::string(2 * kBlock, '\0'));
+}
+
+class TarSinkTest : public testing::Test {
+ protected:
+  static constexpr size_t kBlock = 512;
+
+  static std::span<const uint8_t> Bytes(std::string_view text) {
+    return std::span(reinterpret_cast<const uint8_t*>(text.data()), text.size());
+  }
+
+  /// @brief Returns the value of an octal header field.
+  static uint64_t Octal(std::string_view header, size_t offset, size_t size) {
+    return std::strtoull(std::string(header.substr(offset, size)).c_str(), nullptr, 8);
+  }
+
+  /// @brief Returns whether the header's checksum matches its content.
+  static bool ChecksumMatches(std::string_view header) {
+    uint64_t sum = 0;
+    for (size_t pos = 0; pos < kBlock; ++pos)
+      sum += pos >= 148 && pos < 156 ? ' ' : static_cast<uint8_t>(header[pos]);
+    return sum == Octal(header, 148, 8);
+  }
+
+  std::ostringstream stream_;
+  TarSink sink_{stream_};
+};
+
+TEST_F(TarSinkTest, WritesEntriesInBlocks) {
+  ASSERT_TRUE(sink_.Begin("dir/file.txt", 5));
+  ASSERT_TRUE(sink_.Write(Bytes("hello")));
+  ASSERT_TRUE(sink_.End(true));
+  ASSERT_TRUE(sink_.Finish());
+
+  auto tar = stream_.str();
+  // Header, one data block, two end blocks.
+  ASSERT_EQ(tar.size(), 4 * kBlock);
+  std::string_view header(tar.data(), kBlock);
+  EXPECT_EQ(std::string(header.substr(0, 100).data()), "dir/file.txt");
+  EXPECT_EQ(header.substr(257, 5), "ustar");
+  EXPECT_EQ(Octal(header, 124, 12), 5u);
+  EXPECT_TRUE(ChecksumMatches(header));
+  EXPECT_EQ(tar.substr(kBlock, 5), "hello");
+  EXPECT_EQ(tar.find_first_not_of('\0', kBlock + 5), std::string::npos);
+}
+
+TEST_F(TarSinkTest, SplitsLongNamesIntoPrefix) {
+  std::string directory(120, 'd');
+  ASSERT_TRUE(sink_.Begin(directory + "/name", 0));
+  ASSERT_TRUE(sink_.End(true));
+
+  auto tar = stream_.str();
+  std::string_view header(tar.data(), kBlock);
+  EXPECT_EQ(std::string(header.substr(0, 100).data()), "name");
+  EXPECT_EQ(std::string(header.substr(345, 155).data()), directory);
+  EXPECT_TRUE(ChecksumMatches(header));
+}
+
+TEST_F(TarSinkTest, PadsFailedEntriesToTheirSize) {
+  ASSERT_TRUE(sink_.Begin("short", 1000));
+  ASSERT_TRUE(sink_.Write(Bytes("partial")));
+  ASSERT_TRUE(sink_.End(false));
+  ASSERT_TRUE(sink_.Begin("next", 3));
+  ASSERT_TRUE(sink_.Write(Bytes("abc")));
+  ASSERT_TRUE(sink_.End(true));
+
+  // The next header starts where the announced size says, keeping the stream readable.
+  auto tar = stream_.str();
+  ASSERT_EQ(tar.size(), kBlock + 2 * kBlock + kBlock + kBlock);
+  EXPECT_EQ(std::string(tar.data() + 3 * kBlock), "next");
+  EXPECT_EQ(tar.substr(4 * kBlock, 3), "abc");
+}
+
+}  // namespace
@@ -0,0 +1,74 @@
+#include "merge_groups.hh"
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <string_view>
+
+namespace {
+
+class MergeGroupsTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    path_ = std::filesystem::temp_directory_path() /
+            ("opuslzx-" + std::string(testing::UnitTest::GetInstance()->current_test_info()->name()) + ".lzx");
+    archive_ = std::string("LZX\0\0\0\0\0\0\0", 10);
+  }
+
+  void TearDown() override { std::filesystem::remove(path_); }
+
+  /// @brief Appends an entry header with its name and comment, followed by `pack_size` bytes of packed data.
+  void AddEntry(std::string_view name, uint32_t pack_size, std::string_view comment = {}) {
+    std::array<char, 31> header{};
+    for (int i = 0; i < 4; ++i)
+      header[6 + i] = static_cast<char>(pack_size >> (8 * i));
+    header[14] = static_cast<char>(comment.size());
+    header[30] = static_cast<char>(name.size());
+    archive_.append(header.data(), header.size());
+    archive_ += name;
+    archive_ += comment;
+    archive_.append(pack_size, 'x');
+  }
+
+  std::optional<std::vector<std::vector<std::string>>> Read() {
+    std::ofstream(path_, std::ios::binary) << archive_;
+    return read_merge_groups(path_);
+  }
+
+  std::filesystem::path path_;
+  std::string archive_;
+};
+
+TEST_F(MergeGroupsTest, GroupsMergedEntriesWithTheNextPackedOne) {
+  AddEntry("alone", 5);
+  AddEntry("first", 0, "comment");
+  AddEntry("second", 0);
+  AddEntry("third", 300);
+  AddEntry("dir/last", 1);
+
+  auto groups = Read();
+  ASSERT_TRUE(groups);
+  EXPECT_EQ(*groups, (std::vector<std::vector<std::string>>{
+                         {"alone"}, {"first", "second", "third"}, {"dir/last"}}));
+}
+
+TEST_F(MergeGroupsTest, KeepsGroupCutShortByTruncation) {
+  AddEntry("complete", 2);
+  AddEntry("merged", 0);
+  archive_.append(10, '\0');  // Part of another header.
+
+  auto groups = Read();
+  ASSERT_TRUE(groups);
+  EXPECT_EQ(*groups, (std::vector<std::vector<std::string>>{{"complete"}, {"merged"}}));
+}
+
+TEST_F(MergeGroupsTest, RejectsOtherFiles) {
+  archive_ = "FAKE";
+  EXPECT_FALSE(Read());
+  EXPECT_FALSE(read_merge_groups(path_ / "missing"));
+}
+
+}  // namespace
@@ -0,0 +1,153 @@
+#include "plugin_core.hh"
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <set>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "crc32.hh"
+#include "extract_sink.hh"
+#include "sink_test_util.hh"
+
+namespace {
+
+/// @brief Builds store-mode LZX archives whose entry names come straight from the test.
+class PluginCoreTest : public SinkTest {
+ protected:
+  /// @brief Appends an entry with its header and stored data.
+  void AddEntry(std::string_view name, std::string_view content) {
+    std::array<uint8_t, 31> header{};
+    auto put = [&](size_t offset, uint32_t value) {
+      for (int i = 0; i < 4; ++i)
+        header[offset + i] = static_cast<uint8_t>(value >> (8 * i));
+    };
+    put(2, static_cast<uint32_t>(content.size()));
+    put(6, static_cast<uint32_t>(content.size()));
+    put(22, Crc(content));
+    header[30] = static_cast<uint8_t>(name.size());
+    // The header CRC covers the header, with the CRC field zeroed, and the name.
+    auto crc = crc32_update(0, header);
+    put(26, crc32_update(crc, std::span(reinterpret_cast<const uint8_t*>(name.data()), name.size())));
+
+    archive_.append(reinterpret_cast<const char*>(header.data()), header.size());
+    archive_ += name;
+    archive_ += content;
+  }
+
+  /// @brief Writes the archive and returns the names of the files its tree lists, in name order.
+  std::vector<std::string> List() {
+    auto path = root_ / "test.lzx";
+    WriteFile(path, archive_);
+
+    PluginCore plugin;
+    auto call = plugin.Enter();
+    std::vector<std::string> names;
+    bool found = plugin.ListEntries(path, [&](const std::filesystem::path& name, const LzxEntry&) {
+      names.push_back(name.generic_string());
+      return true;
+    });
+    EXPECT_TRUE(found);
+    return names;
+  }
+
+  // The archive header, then the entries.
+  std::string archive_ = std::string("LZX\0\0\0\0\0\0\0", 10);
+};
+
+TEST_F(PluginCoreTest, NormalizesEntryNames) {
+  AddEntry("./dot/file", "1");
+  AddEntry("dir//double", "2");
+  AddEntry("dir\\back", "3");
+  AddEntry("trailing/", "4");
+  AddEntry("dir/./nested/.", "5");
+
+  EXPECT_EQ(List(), (std::vector<std::string>{"dir/back", "dir/double", "dir/nested", "dot/file", "trailing"}));
+}
+
+TEST_F(PluginCoreTest, LeavesOutEntriesEscapingTheArchive) {
+  AddEntry("../escape", "x");
+  AddEntry("dir/../../escape", "x");
+  AddEntry("dir\\..\\sibling", "x");
+  AddEntry("C:/absolute", "x");
+  AddEntry("volume:file", "x");
+  AddEntry("dir/kept", "kept");
+
+  EXPECT_EQ(List(), (std::vector<std::string>{"dir/kept"}));
+}
+
+TEST_F(PluginCoreTest, IgnoresNamesWithoutComponents) {
+  // Such entries must not turn the root into a file.
+  AddEntry("", "x");
+  AddEntry(".", "x");
+  AddEntry("/", "x");
+  AddEntry("\\./\\", "x");
+  AddEntry("file", "file");
+
+  EXPECT_EQ(List(), (std::vector<std::string>{"file"}));
+}
+
+TEST_F(PluginCoreTest, ExtractionStaysBelowTheDestination) {
+  AddEntry("../escape", "x");
+  AddEntry("C:escape", "x");
+  AddEntry("dir/file", "content");
+
+  auto path = root_ / "test.lzx";
+  WriteFile(path, archive_);
+  auto destination = root_ / "out";
+  std::filesystem::create_directories(destination);
+
+  PluginCore plugin;
+  auto call = plugin.Enter();
+  FileSink sink(destination);
+  EXPECT_TRUE(plugin.ExtractTo(path, sink));
+
+  EXPECT_EQ(ReadFile(destination / "dir" / "file"), "content");
+  EXPECT_FALSE(std::filesystem::exists(root_ / "escape"));
+  EXPECT_EQ(std::distance(std::filesystem::recursive_directory_iterator(destination), {}), 2);
+}
+
+TEST_F(PluginCoreTest, RandomNameSetsBuildConsistentTrees) {
+  // Names drawn from separators, dots, drive colons and two letters; fixed seed so that failures reproduce.
+  constexpr std::string_view kAlphabet = "ab./\\:";
+  uint32_t state = 0x9e3779b9;
+  auto next = [&] { return state = state * 1664525 + 1013904223; };
+
+  for (int round = 0; round < 50; ++round) {
+    archive_.resize(10);
+    std::set<std::string> expected;
+    for (int entry = 0; entry < 40; ++entry) {
+      std::string name(next() % 12, '\0');
+      for (auto& c : name)
+        c = kAlphabet[(next() >> 16) % kAlphabet.size()];
+      AddEntry(name, name);
+
+      // What the tree should hold for the name: its components without empty ones and '.', unless one of them could
+      // leave the archive.
+      std::string normalized;
+      bool escapes = false;
+      for (size_t pos = 0; pos <= name.size();) {
+        auto end = std::min(name.find_first_of("/\\", pos), name.size());
+        auto component = std::string_view(name).substr(pos, end - pos);
+        pos = end + 1;
+        if (component.empty() || component == ".")
+          continue;
+        escapes |= component == ".." || component.find(':') != std::string_view::npos;
+        normalized += (normalized.empty() ? "" : "/") + std::string(component);
+      }
+      if (!escapes && !normalized.empty())
+        expected.insert(normalized);
+    }
+
+    SCOPED_TRACE(round);
+    auto names = List();
+    EXPECT_EQ(std::set<std::string>(names.begin(), names.end()), expected);
+  }
+}
+
+}  // namespace
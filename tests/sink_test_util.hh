@@ -0,0 +1,69 @@
+#pragma once
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include "crc32.hh"
+#include "extract_sink.hh"
+
+/// @brief Fixture for tests of sinks writing below a directory: a fresh, empty `root_` per test, removed afterwards.
+class SinkTest : public testing::Test {
+ protected:
+  /// @brief Outcome of Extract().
+  enum class Extracted { kFailed, kReused, kWritten };
+
+  void SetUp() override {
+    root_ = std::filesystem::temp_directory_path() /
+            ("opuslzx-" + std::string(testing::UnitTest::GetInstance()->current_test_info()->name()));
+    std::filesystem::remove_all(root_);
+    std::filesystem::create_directories(root_);
+  }
+
+  void TearDown() override { std::filesystem::remove_all(root_); }
+
+  static void WriteFile(const std::filesystem::path& path, std::string_view content) {
+    std::ofstream(path, std::ios::binary) << content;
+  }
+
+  static std::string ReadFile(const std::filesystem::path& path) {
+    std::ifstream stream(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(stream), {});
+  }
+
+  static uint32_t Crc(std::string_view content) {
+    return crc32_update(0, std::span(reinterpret_cast<const uint8_t*>(content.data()), content.size()));
+  }
+
+  /// @brief Drives a sink the way PluginCore::DecodeEntry does.
+  /// @param crc CRC of the entry as recorded in the archive; by default that of `content`.
+  /// @param chunk Size of the Write calls; by default the content is passed in two, so that the sink sees data
+  /// continue across calls.
+  static Extracted Extract(ExtractSink& sink,
+                           const std::filesystem::path& name,
+                           std::string_view content,
+                           std::optional<uint32_t> crc = std::nullopt,
+                           size_t chunk = 0) {
+    if (sink.Reuse(name, content.size(), crc.value_or(Crc(content))))
+      return Extracted::kReused;
+    if (!sink.Begin(name, content.size()))
+      return Extracted::kFailed;
+
+    auto data = std::span(reinterpret_cast<const uint8_t*>(content.data()), content.size());
+    if (chunk == 0)
+      chunk = std::max<size_t>(data.size() - data.size() / 2, 1);
+    bool written = true;
+    for (size_t pos = 0; written && pos < data.size(); pos += chunk)
+      written = sink.Write(data.subspan(pos, std::min(chunk, data.size() - pos)));
+    return sink.End(written) && written ? Extracted::kWritten : Extracted::kFailed;
+  }
+
+  std::filesystem::path root_;
+};
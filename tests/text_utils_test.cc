@@ -0,0 +1,116 @@
+#include "text_utils.hh"
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <string>
+#include <string_view>
+
+namespace {
+
+// Longer than one SIMD block, so that both the vector and the scalar paths run.
+constexpr std::string_view kAscii = "a plain ascii name, long enough";
+
+TEST(TextUtilsTest, Utf8ToWideConvertsNonAsciiTail) {
+  std::array<wchar_t, 64> out;
+  auto utf8 = std::string(kAscii) + "/\xc3\xa9t\xc3\xa9 \xe2\x82\xac";
+
+  auto length = utf8_to_wide(utf8, out);
+
+  auto expected = utf8_to_wstring(kAscii) + L"/été €";
+  EXPECT_EQ(std::wstring_view(out.data(), length), expected);
+  EXPECT_EQ(out[length], L'\0');
+  EXPECT_EQ(utf8_to_wstring(utf8), expected);
+}
+
+TEST(TextUtilsTest, Utf8ToWideTruncates) {
+  // Within the ASCII prefix.
+  std::array<wchar_t, 8> small;
+  EXPECT_EQ(utf8_to_wide(kAscii, small), small.size() - 1);
+  EXPECT_EQ(std::wstring_view(small.data()), L"a plain");
+
+  // Within the non-ASCII tail: the prefix and as many characters of the tail as fit.
+  std::array<wchar_t, 6> out;
+  EXPECT_EQ(utf8_to_wide("ab\xc3\xa9\xc3\xa9\xc3\xa9\xc3\xa9", out), out.size() - 1);
+  EXPECT_EQ(std::wstring_view(out.data()), L"abééé");
+
+  // The prefix filling the buffer exactly.
+  std::array<wchar_t, 3> exact;
+  EXPECT_EQ(utf8_to_wide("ab\xc3\xa9", exact), 2u);
+  EXPECT_EQ(std::wstring_view(exact.data()), L"ab");
+
+  std::span<wchar_t> empty;
+  EXPECT_EQ(utf8_to_wide("ab", empty), 0u);
+}
+
+TEST(TextUtilsTest, Utf8ToWideReplacesInvalidSequences) {
+  std::array<wchar_t, 16> out;
+  auto length = utf8_to_wide("a\xff" "b\xc3", out);
+  EXPECT_EQ(std::wstring_view(out.data(), length), L"a�b�");
+}
+
+TEST(TextUtilsTest, WideToUtf8RoundTrips) {
+  std::wstring wide = utf8_to_wstring(kAscii) + L"/é€";
+  std::array<char, 64> out;
+
+  auto length = wide_to_utf8(wide, out);
+
+  EXPECT_EQ(std::string_view(out.data(), length), std::string(kAscii) + "/\xc3\xa9\xe2\x82\xac");
+  EXPECT_EQ(out[length], '\0');
+}
+
+TEST(TextUtilsTest, WideToUtf8NeverSplitsACharacter) {
+  // "a" fits, and so does "é" (two bytes), but not the three bytes of the euro sign.
+  std::array<char, 5> out;
+  EXPECT_EQ(wide_to_utf8(L"aé€", out), 3u);
+  EXPECT_EQ(std::string_view(out.data()), "a\xc3\xa9");
+}
+
+TEST(TextUtilsTest, WstringToLatin1SubstitutesUnrepresentable) {
+  std::wstring wide = utf8_to_wstring(kAscii) + L"é€ÿ";
+
+  EXPECT_EQ(wstring_to_latin1(wide), std::string(kAscii) + "\xe9?\xff");
+  EXPECT_EQ(wstring_to_latin1(L""), "");
+}
+
+TEST(TextUtilsTest, WideToLatin1Truncates) {
+  std::array<char, 4> out;
+  EXPECT_EQ(wide_to_latin1(L"é€abc", out), 3u);
+  EXPECT_EQ(std::string_view(out.data()), "\xe9?a");
+}
+
+TEST(TextUtilsTest, WildcardMatch) {
+  EXPECT_TRUE(wildcard_match("*", ""));
+  EXPECT_TRUE(wildcard_match("*.*", "noextension"));
+  EXPECT_TRUE(wildcard_match("*.lzx", "archive.lzx"));
+  EXPECT_FALSE(wildcard_match("*.lzx", "archive.LZX"));
+  EXPECT_TRUE(wildcard_match("a*b*c", "aXXbYYbZc"));
+  EXPECT_FALSE(wildcard_match("a*b*c", "aXXbYYbZ"));
+  EXPECT_TRUE(wildcard_match("file?.txt", "file1.txt"));
+  EXPECT_FALSE(wildcard_match("file?.txt", "file.txt"));
+  EXPECT_FALSE(wildcard_match("file?.txt", "file12.txt"));
+  EXPECT_TRUE(wildcard_match("exact", "exact"));
+  EXPECT_FALSE(wildcard_match("exact", "exactly"));
+  EXPECT_TRUE(wildcard_match("trailing**", "trailing"));
+}
+
+TEST(TextUtilsTest, WildcardQuestionMarkMatchesOneUtf8Character) {
+  EXPECT_TRUE(wildcard_match("caf?", "caf\xc3\xa9"));
+  EXPECT_TRUE(wildcard_match("?", "\xe2\x82\xac"));
+  EXPECT_FALSE(wildcard_match("??", "\xe2\x82\xac"));
+  EXPECT_TRUE(wildcard_match("*?x", "\xc3\xa9x"));
+}
+
+TEST(TextUtilsTest, IsArchiveName) {
+  using Native = std::filesystem::path::string_type;
+  auto check = [](const char* name) { return is_archive_name(std::filesystem::path(name).native()); };
+  EXPECT_TRUE(check("archive.lzx"));
+  EXPECT_TRUE(check("ARCHIVE.LZX"));
+  EXPECT_TRUE(check("dir/Mixed.LzX"));
+  EXPECT_FALSE(check(".lzx"));
+  EXPECT_FALSE(check("archive.lha"));
+  EXPECT_FALSE(check("archive.lzx.bak"));
+  EXPECT_FALSE(is_archive_name(Native()));
+}
+
+}  // namespace
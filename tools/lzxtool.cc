@@ -0,0 +1,502 @@
+// Command-line front end over the plugin core, for batch jobs outside Directory Opus. Archives are listed, tested and
+// extracted through the same PluginCore code the file manager drives, on any platform.
+//
+// Usage:
+//   lzxtool list [--json] [--time] ARCHIVE...
+//   lzxtool test [--json] [--time] [--jobs N] ARCHIVE...
+//   lzxtool extract [--time] [--sync] [-C DIR] ARCHIVE...
+//   lzxtool extract [--time] --tar FILE ARCHIVE...
+//   lzxtool cat [--] ARCHIVE ENTRY...
+//   lzxtool grep [-l] [--time] [--] TEXT ARCHIVE...
+//
+// list     Prints the size, CRC and name of every entry. With --json, prints one JSON object per archive and line.
+// test     Decodes every entry and verifies its CRC, without writing anything. Tests N archives at a time (default: one
+//          per hardware thread).
+// extract  Extracts each archive into DIR/<archive name without extension> (default: the current directory), all
+//          archives at once on the ExtractScheduler. With --sync, files are stamped with the archive's modification
+//          time, and targets from an earlier --sync run that still have the entry's size, that time and CRC are kept.
+//          With --tar, writes all archives, one after the other, into a single ustar archive FILE instead (- for
+//          standard output), each under a directory named as above; -C and --sync do not apply.
+// cat      Writes the data of the given entries, in order, to standard output.
+// grep     Searches the decoded data of every entry for TEXT, taken byte for byte, and prints ARCHIVE:ENTRY:OFFSET for
+//          each match, in entry and offset order. With -l, prints ARCHIVE:ENTRY once for each entry that matches.
+// --time   Reports the time taken per archive and in total, on standard error. For extract, an archive's time runs
+//          from its submission to the scheduler until its last entry is written.
+// --       Ends the options: later arguments are operands even if they start with -, e.g. grep text.
+//
+// Options a command does not take are rejected.
+// Exits with 0 on success, 1 if any archive or entry failed (or, for grep, nothing matched), and 2 on usage errors.
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#include "extract_scheduler.hh"
+#include "extract_sink.hh"
+#include "plugin_core.hh"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+  bool json_{};
+  bool names_only_{};
+  bool time_{};
+  bool sync_{};
+  size_t jobs_{std::max(1u, std::thread::hardware_concurrency())};
+  std::filesystem::path destination_{"."};
+  std::optional<std::filesystem::path> tar_;
+  std::vector<std::filesystem::path> operands_;
+};
+
+double elapsed_ms(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+std::string to_utf8(const std::filesystem::path& path) {
+  auto text = path.generic_u8string();
+  return std::string(text.begin(), text.end());
+}
+
+/// @brief Appends `text` to `out` as a quoted JSON string.
+void append_json_string(std::string& out, std::string_view text) {
+  out += '"';
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char escape[8];
+      std::snprintf(escape, sizeof(escape), "\\u%04x", c);
+      out += escape;
+    } else {
+      out += c;
+    }
+  }
+  out += '"';
+}
+
+/// @brief Returns the operand as an absolute path, the form Plugin expects.
+std::filesystem::path absolute_path(const std::filesystem::path& operand) {
+  std::error_code error;
+  auto path = std::filesystem::absolute(operand, error);
+  return error ? operand : path;
+}
+
+void report_time(const std::filesystem::path& archive, double ms) {
+  std::fprintf(stderr, "%s: %.1f ms\n", to_utf8(archive).c_str(), ms);
+}
+
+/// @brief Decodes entries without keeping their data, recording those that fail to verify.
+class VerifySink : public ExtractSink {
+ public:
+  bool Begin(const std::filesystem::path& name, uint64_t size) override {
+    name_ = name;
+    return true;
+  }
+  bool Write(std::span<const uint8_t> data) override { return true; }
+  bool End(bool ok) override {
+    ++entries_;
+    if (!ok)
+      failed_.push_back(name_);
+    return true;
+  }
+
+  size_t entries() const { return entries_; }
+  const std::vector<std::filesystem::path>& failed() const { return failed_; }
+
+ private:
+  std::filesystem::path name_;
+  size_t entries_{};
+  std::vector<std::filesystem::path> failed_;
+};
+
+int list(const Options& options) {
+  int result = 0;
+  for (const auto& archive : options.operands_) {
+    auto start = Clock::now();
+    PluginCore plugin;
+    auto call = plugin.Enter();
+
+    std::string json;
+    size_t count{};
+    uint64_t total{};
+    auto on_entry = [&](const std::filesystem::path& name, const LzxEntry& entry) {
+      if (options.json_) {
+        char fields[96];
+        std::snprintf(fields, sizeof(fields), ",\"size\":%llu,\"crc\":\"%08x\",\"segments\":%zu}",
+                      static_cast<unsigned long long>(entry.unpack_size()), static_cast<unsigned>(entry.crc()),
+                      static_cast<size_t>(std::ranges::distance(entry.segments())));
+        json += count ? ",{\"name\":" : "{\"name\":";
+        append_json_string(json, to_utf8(name));
+        json += fields;
+      } else {
+        std::printf("%12llu  %08x  %s\n", static_cast<unsigned long long>(entry.unpack_size()),
+                    static_cast<unsigned>(entry.crc()), to_utf8(name).c_str());
+      }
+      ++count;
+      total += entry.unpack_size();
+      return true;
+    };
+    bool found = plugin.ListEntries(absolute_path(archive), on_entry);
+
+    if (!found) {
+      std::fprintf(stderr, "%s: cannot open (error %d)\n", to_utf8(archive).c_str(), plugin.GetError());
+      result = 1;
+      continue;
+    }
+
+    if (options.json_) {
+      std::string line = "{\"archive\":";
+      append_json_string(line, to_utf8(archive));
+      line += ",\"entries\":[" + json + "]}";
+      std::puts(line.c_str());
+    } else {
+      std::printf("%12llu  %zu entries in %s\n\n", static_cast<unsigned long long>(total), count,
+                  to_utf8(archive).c_str());
+    }
+    if (options.time_)
+      report_time(archive, elapsed_ms(start));
+  }
+  return result;
+}
+
+int test(const Options& options) {
+  struct Result {
+    bool opened_;
+    bool ok_;
+    int error_;
+    size_t entries_;
+    std::vector<std::filesystem::path> failed_;
+    double ms_;
+  };
+
+  // Archives are independent, so each worker tests whole archives with a PluginCore of its own.
+  std::vector<Result> results(options.operands_.size());
+  std::atomic<size_t> next{};
+  {
+    std::vector<std::jthread> workers;
+    for (size_t worker = 0; worker < std::min(options.jobs_, results.size()); ++worker) {
+      workers.emplace_back([&] {
+        for (size_t index; (index = next++) < results.size();) {
+          auto start = Clock::now();
+          auto archive = absolute_path(options.operands_[index]);
+          PluginCore plugin;
+          auto call = plugin.Enter();
+          if (!plugin.LoadFile(archive)) {
+            results[index] = {false, false, plugin.GetError(), 0, {}, elapsed_ms(start)};
+            continue;
+          }
+          VerifySink sink;
+          bool ok = plugin.ExtractTo(archive, sink);
+          results[index] = {true, ok, plugin.GetError(), sink.entries(), sink.failed(), elapsed_ms(start)};
+        }
+      });
+    }
+  }
+
+  int exit_code = 0;
+  for (size_t index = 0; index < results.size(); ++index) {
+    const auto& archive = options.operands_[index];
+    const auto& result = results[index];
+    bool ok = result.ok_ && result.failed_.empty();
+    if (!ok)
+      exit_code = 1;
+
+    if (options.json_) {
+      std::string line = "{\"archive\":";
+      append_json_string(line, to_utf8(archive));
+      line += ok ? ",\"ok\":true" : ",\"ok\":false";
+      line += ",\"entries\":" + std::to_string(result.entries_) + ",\"error\":" + std::to_string(result.error_);
+      line += ",\"failed\":[";
+      for (const auto& name : result.failed_) {
+        if (&name != &result.failed_.front())
+          line += ',';
+        append_json_string(line, to_utf8(name));
+      }
+      line += "]}";
+      std::puts(line.c_str());
+    } else {
+      for (const auto& name : result.failed_)
+        std::printf("%s: %s: CRC error\n", to_utf8(archive).c_str(), to_utf8(name).c_str());
+      if (!result.opened_)
+        std::printf("%s: cannot open (error %d)\n", to_utf8(archive).c_str(), result.error_);
+      else
+        std::printf("%s: %zu entries, %s\n", to_utf8(archive).c_str(), result.entries_, ok ? "OK" : "FAILED");
+    }
+    if (options.time_)
+      report_time(archive, result.ms_);
+  }
+  return exit_code;
+}
+
+/// @brief Passes entries on to another sink, below a directory.
+class PrefixSink : public ExtractSink {
+ public:
+  PrefixSink(ExtractSink& sink, std::filesystem::path prefix) : sink_(sink), prefix_(std::move(prefix)) {}
+
+  bool Begin(const std::filesystem::path& name, uint64_t size) override { return sink_.Begin(prefix_ / name, size); }
+  bool Write(std::span<const uint8_t> data) override { return sink_.Write(data); }
+  bool End(bool ok) override { return sink_.End(ok); }
+
+ private:
+  ExtractSink& sink_;
+  std::filesystem::path prefix_;
+};
+
+int extract_tar(const Options& options) {
+  std::ofstream file;
+  std::ostream* stream = &std::cout;
+  if (*options.tar_ == "-") {
+#ifdef _WIN32
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+  } else {
+    file.open(*options.tar_, std::ios::binary);
+    if (!file) {
+      std::fprintf(stderr, "%s: cannot create\n", to_utf8(*options.tar_).c_str());
+      return 1;
+    }
+    stream = &file;
+  }
+
+  // A tar stream is written in order, so archives are extracted one after the other.
+  TarSink tar(*stream);
+  int exit_code = 0;
+  for (const auto& archive : options.operands_) {
+    auto start = Clock::now();
+    PluginCore plugin;
+    auto call = plugin.Enter();
+    PrefixSink sink(tar, archive.stem());
+    if (!plugin.ExtractTo(absolute_path(archive), sink)) {
+      std::fprintf(stderr, "%s: extraction failed (error %d)\n", to_utf8(archive).c_str(), plugin.GetError());
+      exit_code = 1;
+    }
+    if (options.time_)
+      report_time(archive, elapsed_ms(start));
+  }
+  if (!tar.Finish()) {
+    std::fprintf(stderr, "%s: write failed\n", to_utf8(*options.tar_).c_str());
+    exit_code = 1;
+  }
+  return exit_code;
+}
+
+int extract(const Options& options) {
+  if (options.tar_)
+    return extract_tar(options);
+
+  auto start = Clock::now();
+  auto destination = absolute_path(options.destination_);
+  std::vector<std::shared_future<ExtractScheduler::Result>> results;
+  for (const auto& archive : options.operands_)
+    results.push_back(ExtractScheduler::Instance().Submit(absolute_path(archive), destination, options.sync_));
+
+  // Archives complete in any order; each result carries its own completion time, so waiting in order loses nothing.
+  int exit_code = 0;
+  for (size_t index = 0; index < results.size(); ++index) {
+    const auto& archive = options.operands_[index];
+    const auto& result = results[index].get();
+    if (!result.ok_) {
+      std::fprintf(stderr, "%s: extraction failed\n", to_utf8(archive).c_str());
+      exit_code = 1;
+    }
+    if (options.time_)
+      report_time(archive, std::chrono::duration<double, std::milli>(result.finished_ - start).count());
+  }
+  return exit_code;
+}
+
+int cat(const Options& options) {
+  if (options.operands_.size() < 2)
+    return 2;
+
+#ifdef _WIN32
+  _setmode(_fileno(stdout), _O_BINARY);
+#endif
+
+  PluginCore plugin;
+  auto call = plugin.Enter();
+  StreamSink sink(std::cout);
+  auto archive = absolute_path(options.operands_.front());
+  int exit_code = 0;
+  for (size_t index = 1; index < options.operands_.size(); ++index) {
+    if (plugin.ExtractTo(archive / options.operands_[index], sink))
+      continue;
+    std::fprintf(stderr, "%s: cannot extract (error %d)\n", to_utf8(options.operands_[index]).c_str(),
+                 plugin.GetError());
+    exit_code = 1;
+  }
+  if (!sink.Finish())
+    exit_code = 1;
+  return exit_code;
+}
+
+int grep(const Options& options) {
+  if (options.operands_.size() < 2)
+    return 2;
+  // Operands are held as paths, in UTF-16 on Windows; search for the UTF-8 text there too.
+  auto u8_text = options.operands_.front().u8string();
+  std::string text(u8_text.begin(), u8_text.end());
+  if (text.empty())
+    return 2;
+
+  bool failed = false;
+  bool matched = false;
+  for (size_t index = 1; index < options.operands_.size(); ++index) {
+    const auto& archive = options.operands_[index];
+    auto start = Clock::now();
+    PluginCore plugin;
+    auto call = plugin.Enter();
+
+    // Entries are searched in parallel, so matches arrive out of order.
+    std::vector<std::pair<std::filesystem::path, uint64_t>> matches;
+    bool ok = plugin.SearchContent(absolute_path(archive), text, options.names_only_,
+                                   [&](const std::filesystem::path& name, uint64_t offset) {
+                                     matches.emplace_back(name, offset);
+                                     return true;
+                                   });
+    if (!ok) {
+      std::fprintf(stderr, "%s: search failed (error %d)\n", to_utf8(archive).c_str(), plugin.GetError());
+      failed = true;
+    }
+
+    std::ranges::sort(matches);
+    for (const auto& [name, offset] : matches) {
+      if (options.names_only_)
+        std::printf("%s:%s\n", to_utf8(archive).c_str(), to_utf8(name).c_str());
+      else
+        std::printf("%s:%s:%llu\n", to_utf8(archive).c_str(), to_utf8(name).c_str(),
+                    static_cast<unsigned long long>(offset));
+    }
+    matched = matched || !matches.empty();
+    if (options.time_)
+      report_time(archive, elapsed_ms(start));
+  }
+  return failed || !matched ? 1 : 0;
+}
+
+/// @brief Returns whether `command` takes `option`, one of the options in the usage.
+bool takes_option(std::string_view command, std::string_view option) {
+  if (option == "--json")
+    return command == "list" || command == "test";
+  if (option == "--time")
+    return command != "cat";
+  if (option == "--jobs")
+    return command == "test";
+  if (option == "-l")
+    return command == "grep";
+  // --sync, --tar and -C.
+  return command == "extract";
+}
+
+int usage(const char* program) {
+  std::fprintf(stderr,
+               "usage: %s list [--json] [--time] ARCHIVE...\n"
+               "       %s test [--json] [--time] [--jobs N] ARCHIVE...\n"
+               "       %s extract [--time] [--sync] [-C DIR] ARCHIVE...\n"
+               "       %s extract [--time] --tar FILE ARCHIVE...\n"
+               "       %s cat [--] ARCHIVE ENTRY...\n"
+               "       %s grep [-l] [--time] [--] TEXT ARCHIVE...\n",
+               program, program, program, program, program, program);
+  return 2;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 3)
+    return usage(argv[0]);
+
+  std::string_view command = argv[1];
+  Options options;
+  bool operands_only = false;
+  for (int arg = 2; arg < argc; ++arg) {
+    std::string_view option = argv[arg];
+    if (operands_only || option.size() < 2 || !option.starts_with("-")) {
+      options.operands_.emplace_back(argv[arg]);
+      continue;
+    }
+    if (option == "--") {
+      operands_only = true;
+      continue;
+    }
+
+    constexpr std::string_view kOptions[] = {"--json", "--time", "-l", "--sync", "--jobs", "--tar", "-C"};
+    if (std::ranges::find(kOptions, option) == std::ranges::end(kOptions)) {
+      std::fprintf(stderr, "unknown option %s\n", argv[arg]);
+      return 2;
+    }
+    if (!takes_option(command, option)) {
+      std::fprintf(stderr, "%s does not take %s\n", argv[1], argv[arg]);
+      return 2;
+    }
+    if ((option == "--jobs" || option == "--tar" || option == "-C") && arg + 1 == argc) {
+      std::fprintf(stderr, "missing value for %s\n", argv[arg]);
+      return 2;
+    }
+
+    if (option == "--json") {
+      options.json_ = true;
+    } else if (option == "--time") {
+      options.time_ = true;
+    } else if (option == "-l") {
+      options.names_only_ = true;
+    } else if (option == "--sync") {
+      options.sync_ = true;
+    } else if (option == "--jobs") {
+      std::string_view value = argv[++arg];
+      auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), options.jobs_);
+      if (error != std::errc() || end != value.data() + value.size() || options.jobs_ == 0) {
+        std::fprintf(stderr, "invalid --jobs value %s\n", argv[arg]);
+        return 2;
+      }
+    } else if (option == "--tar") {
+      options.tar_ = argv[++arg];
+    } else {
+      options.destination_ = argv[++arg];
+    }
+  }
+  if (options.operands_.empty())
+    return usage(argv[0]);
+
+  auto start = Clock::now();
+  int result;
+  if (command == "list")
+    result = list(options);
+  else if (command == "test")
+    result = test(options);
+  else if (command == "extract")
+    result = extract(options);
+  else if (command == "cat")
+    result = cat(options);
+  else if (command == "grep")
+    result = grep(options);
+  else
+    return usage(argv[0]);
+
+  if (result == 2)
+    return usage(argv[0]);
+  if (options.time_)
+    std::fprintf(stderr, "total: %.1f ms\n", elapsed_ms(start));
+  return result;
+}
@@ -0,0 +1,672 @@
+// Replays a VFS call trace recorded with OPUSLZX_TRACE (see src/trace.hh) the way Opus would have made the calls, and
+// reports per-call latency percentiles.
+//
+// Usage:
+//   trace_replay (<plugin.dll> | --core) <trace.json> [--map FROM=TO]... [--extract-to DIR] [--repeat N]
+//                [--report FILE] [--baseline FILE] [--tolerance PERCENT]
+//
+// Given a DLL (Windows only), the calls go through its exports. With --core, on any platform, they go straight to
+// the plugin core linked into the tool: enumerations and the other lookups resolve paths in the archive tree, files
+// are opened and read through PluginCore::OpenFile and ReadFile, and extractions run PluginCore::ExtractTo into a
+// FileSink. The VFS layer on top (file data headers, find data) is not exercised then; context verbs, batch operations
+// and property queries are skipped.
+//
+// Calls whose path was too long to record in full, and extractions of several files (the recorder keeps the first
+// path only), cannot be replayed faithfully. They are skipped in either mode and counted separately.
+//
+// --map         Rewrites recorded paths starting with FROM to start with TO, e.g. to point at a local corpus. With
+//               --core outside Windows, backslashes in the recorded paths are then turned into slashes.
+// --extract-to  Destination of replayed extractions; defaults to a directory in the temporary directory.
+// --repeat      Replays the whole trace N times.
+// --report      Writes the per-call statistics to FILE, as tab-separated values.
+// --baseline    Compares p99 latencies against a report written earlier; exits with 1 if any call regressed by more
+//               than the tolerance (default 10%).
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#ifdef _WIN32
+// clang-format off
+#include "plugin support.h"
+#include "vfs plugins.h"
+// clang-format on
+#endif
+
+#include "archive_path.hh"
+#include "extract_sink.hh"
+#include "plugin_core.hh"
+#include "text_utils.hh"
+
+namespace {
+
+/// @brief One recorded call.
+struct Event {
+  std::string name_;
+  double start_{};
+  uint64_t plugin_{};
+  uint64_t handle_{};
+  uint64_t size_{};
+  uint64_t result_{};
+  std::string path_;
+  bool truncated_{};
+};
+
+/// @brief Per-call latency statistics, in microseconds.
+struct Stats {
+  size_t count_{};
+  double p50_{};
+  double p90_{};
+  double p99_{};
+  double max_{};
+};
+
+/// @brief Returns the value following `"key":` in a trace line, as raw text up to the next delimiter.
+std::optional<std::string_view> find_field(std::string_view line, std::string_view key) {
+  std::string pattern = "\"" + std::string(key) + "\":";
+  auto pos = line.find(pattern);
+  if (pos == std::string_view::npos)
+    return std::nullopt;
+  line.remove_prefix(pos + pattern.size());
+  return line.substr(0, line.find_first_of(",}"));
+}
+
+uint64_t number_field(std::string_view line, std::string_view key) {
+  auto text = find_field(line, key);
+  return text ? std::strtoull(std::string(*text).c_str(), nullptr, 10) : 0;
+}
+
+/// @brief Returns the unescaped contents of the JSON string following `"key":`.
+std::string string_field(std::string_view line, std::string_view key) {
+  std::string pattern = "\"" + std::string(key) + "\":\"";
+  auto pos = line.find(pattern);
+  if (pos == std::string_view::npos)
+    return {};
+
+  std::string result;
+  for (size_t i = pos + pattern.size(); i < line.size() && line[i] != '"'; ++i) {
+    if (line[i] != '\\' || i + 1 >= line.size()) {
+      result.push_back(line[i]);
+    } else if (line[++i] == 'u' && i + 4 < line.size()) {
+      // The recorder only escapes control characters this way.
+      result.push_back(static_cast<char>(std::strtoul(std::string(line.substr(i + 1, 4)).c_str(), nullptr, 16)));
+      i += 4;
+    } else {
+      result.push_back(line[i]);
+    }
+  }
+  return result;
+}
+
+/// @brief Reads a trace written by the recorder: one event per line. Events of all threads are merged by start time.
+std::vector<Event> read_trace(const std::filesystem::path& path) {
+  std::vector<Event> events;
+  std::ifstream stream(path);
+  std::string line;
+  while (std::getline(stream, line)) {
+    // Only complete events are calls; counter events carry plugin-wide statistics.
+    if (!line.starts_with("{\"name\":") || line.find("\"ph\":\"X\"") == std::string::npos)
+      continue;
+
+    Event& event = events.emplace_back();
+    event.name_ = string_field(line, "name");
+    event.start_ = std::strtod(std::string(find_field(line, "ts").value_or("0")).c_str(), nullptr);
+    event.plugin_ = number_field(line, "plugin");
+    event.handle_ = number_field(line, "handle");
+    event.size_ = number_field(line, "size");
+    event.result_ = number_field(line, "result");
+    event.path_ = string_field(line, "path");
+    event.truncated_ = number_field(line, "truncated") != 0;
+  }
+  std::ranges::stable_sort(events, {}, &Event::start_);
+  return events;
+}
+
+std::map<std::string, Stats> read_report(const std::filesystem::path& path) {
+  std::map<std::string, Stats> report;
+  std::ifstream stream(path);
+  std::string name;
+  Stats stats;
+  while (stream >> name >> stats.count_ >> stats.p50_ >> stats.p90_ >> stats.p99_ >> stats.max_)
+    report.insert_or_assign(name, stats);
+  return report;
+}
+
+/// @brief Re-issues recorded calls, translating recorded plugin instances and handles to live ones.
+class Replayer {
+ public:
+  virtual ~Replayer() = default;
+
+  /// @brief Replays one call.
+  /// @return Duration of the call in microseconds, or nullopt if the call was skipped.
+  virtual std::optional<double> Replay(const Event& event) = 0;
+
+ protected:
+  using Clock = std::chrono::steady_clock;
+
+  Replayer(std::vector<std::pair<std::string, std::string>> mappings, std::filesystem::path extract_to)
+      : mappings_(std::move(mappings)), extract_to_(std::move(extract_to)) {}
+
+  /// @brief Applies the first matching --map rewrite.
+  std::string MapPath(std::string_view path) const {
+    for (const auto& [from, to] : mappings_) {
+      if (path.starts_with(from))
+        return to + std::string(path.substr(from.size()));
+    }
+    return std::string(path);
+  }
+
+  static double Microseconds(Clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+  }
+
+  std::vector<std::pair<std::string, std::string>> mappings_;
+  std::filesystem::path extract_to_;
+  std::vector<uint8_t> buffer_;
+};
+
+#ifdef _WIN32
+/// @brief Signatures of the plugin exports, as declared in dllmain.cpp.
+struct Exports {
+  using Create = void*(WINAPI*)(LPGUID);
+  using Clone = void*(WINAPI*)(void*);
+  using Destroy = void(WINAPI*)(void*);
+  using ReadDirectory = bool (*)(void*, LPVFSFUNCDATA, LPVFSREADDIRDATAW);
+  using CreateFile = void*(WINAPI*)(void*, LPVFSFUNCDATA, LPWSTR, DWORD, DWORD, DWORD, LPFILETIME);
+  using ReadFile = bool(WINAPI*)(void*, LPVFSFUNCDATA, void*, LPVOID, DWORD, LPDWORD);
+  using CloseFile = void(WINAPI*)(void*, LPVFSFUNCDATA, void*);
+  using GetFileAttr = BOOL(WINAPI*)(void*, LPVFSFUNCDATA, LPWSTR, LPDWORD);
+  using GetFileSize = BOOL(WINAPI*)(void*, LPVFSFUNCDATA, LPWSTR, void*, unsigned __int64*);
+  using GetFileInformation = LPVFSFILEDATAHEADER(WINAPI*)(void*, LPVFSFUNCDATA, LPWSTR, HANDLE, DWORD);
+  using FindFirst = void*(WINAPI*)(void*, LPVFSFUNCDATA, LPWSTR, LPWIN32_FIND_DATA, HANDLE);
+  using FindNext = BOOL(WINAPI*)(void*, LPVFSFUNCDATA, void*, LPWIN32_FIND_DATA);
+  using FindClose = void(WINAPI*)(void*, void*);
+  using ExtractFiles = BOOL(WINAPI*)(void*, LPVFSFUNCDATA, LPVFSEXTRACTFILESDATAW);
+
+  Create create_;
+  Clone clone_;
+  Destroy destroy_;
+  ReadDirectory read_directory_;
+  CreateFile create_file_;
+  ReadFile read_file_;
+  CloseFile close_file_;
+  GetFileAttr get_file_attr_;
+  GetFileSize get_file_size_;
+  GetFileInformation get_file_information_;
+  FindFirst find_first_;
+  FindNext find_next_;
+  FindClose find_close_;
+  ExtractFiles extract_files_;
+};
+
+template <typename T>
+bool resolve(HMODULE module, const char* name, T& function) {
+  function = reinterpret_cast<T>(GetProcAddress(module, name));
+  if (!function)
+    std::fprintf(stderr, "missing export %s\n", name);
+  return function != nullptr;
+}
+
+std::optional<Exports> load_exports(HMODULE module) {
+  Exports exports{};
+  bool ok = resolve(module, "VFS_Create", exports.create_) & resolve(module, "VFS_Clone", exports.clone_) &
+            resolve(module, "VFS_Destroy", exports.destroy_) &
+            resolve(module, "VFS_ReadDirectoryW", exports.read_directory_) &
+            resolve(module, "VFS_CreateFileW", exports.create_file_) &
+            resolve(module, "VFS_ReadFile", exports.read_file_) &
+            resolve(module, "VFS_CloseFile", exports.close_file_) &
+            resolve(module, "VFS_GetFileAttrW", exports.get_file_attr_) &
+            resolve(module, "VFS_GetFileSizeW", exports.get_file_size_) &
+            resolve(module, "VFS_GetFileInformationW", exports.get_file_information_) &
+            resolve(module, "VFS_FindFirstFileW", exports.find_first_) &
+            resolve(module, "VFS_FindNextFileW", exports.find_next_) &
+            resolve(module, "VFS_FindClose", exports.find_close_) &
+            resolve(module, "VFS_ExtractFilesW", exports.extract_files_);
+  return ok ? std::optional(exports) : std::nullopt;
+}
+
+/// @brief Replays calls through the exports of the plugin DLL.
+class DllReplayer : public Replayer {
+ public:
+  DllReplayer(const Exports& exports,
+              std::vector<std::pair<std::string, std::string>> mappings,
+              std::filesystem::path extract_to)
+      : Replayer(std::move(mappings), std::move(extract_to)), exports_(exports) {
+    heap_ = HeapCreate(0, 0, 0);
+  }
+
+  ~DllReplayer() override {
+    // Release whatever the trace left open, as Opus would when closing the lister.
+    for (auto& [recorded, handle] : files_) {
+      if (plugins_.contains(handle.first))
+        exports_.close_file_(plugins_[handle.first], nullptr, handle.second);
+    }
+    for (auto& [recorded, handle] : finds_) {
+      if (plugins_.contains(handle.first))
+        exports_.find_close_(plugins_[handle.first], handle.second);
+    }
+    for (auto& [recorded, plugin] : plugins_)
+      exports_.destroy_(plugin);
+    HeapDestroy(heap_);
+  }
+
+  std::optional<double> Replay(const Event& event) override {
+    auto found = plugins_.find(event.plugin_);
+    void* plugin = found != plugins_.end() ? found->second : nullptr;
+    auto path = utf8_to_wstring(MapPath(event.path_));
+    LPWSTR path_ptr = path.data();
+
+    auto start = Clock::now();
+    if (event.name_ == "VFS_Create") {
+      plugins_[event.result_] = exports_.create_(nullptr);
+    } else if (!plugin) {
+      // Instance was created before recording started or failed to create; nothing to replay against.
+      return std::nullopt;
+    } else if (event.name_ == "VFS_Clone") {
+      plugins_[event.result_] = exports_.clone_(plugin);
+    } else if (event.name_ == "VFS_Destroy") {
+      exports_.destroy_(plugin);
+      plugins_.erase(event.plugin_);
+    } else if (event.name_ == "VFS_ReadDirectoryW") {
+      VFSREADDIRDATAW data{};
+      data.cbSize = sizeof(data);
+      data.lpszPath = path_ptr;
+      data.vfsReadOp = static_cast<decltype(data.vfsReadOp)>(event.size_);
+      data.hMemHeap = heap_;
+      exports_.read_directory_(plugin, nullptr, &data);
+    } else if (event.name_ == "VFS_CreateFileW") {
+      if (auto* file = exports_.create_file_(plugin, nullptr, path_ptr, static_cast<DWORD>(event.size_), 0, 0, nullptr))
+        files_[event.result_] = {event.plugin_, file};
+    } else if (event.name_ == "VFS_ReadFile") {
+      auto file = files_.find(event.handle_);
+      if (file == files_.end())
+        return std::nullopt;
+      buffer_.resize(event.size_);
+      DWORD read{};
+      start = Clock::now();
+      exports_.read_file_(plugin, nullptr, file->second.second, buffer_.data(), static_cast<DWORD>(event.size_), &read);
+    } else if (event.name_ == "VFS_CloseFile") {
+      auto file = files_.find(event.handle_);
+      if (file == files_.end())
+        return std::nullopt;
+      exports_.close_file_(plugin, nullptr, file->second.second);
+      files_.erase(file);
+    } else if (event.name_ == "VFS_GetFileAttrW") {
+      DWORD attr{};
+      exports_.get_file_attr_(plugin, nullptr, path_ptr, &attr);
+    } else if (event.name_ == "VFS_GetFileSizeW") {
+      auto file = files_.find(event.handle_);
+      unsigned __int64 size{};
+      exports_.get_file_size_(plugin, nullptr, path_ptr, file != files_.end() ? file->second.second : nullptr, &size);
+    } else if (event.name_ == "VFS_GetFileInformationW") {
+      exports_.get_file_information_(plugin, nullptr, path_ptr, heap_, 0);
+    } else if (event.name_ == "VFS_FindFirstFileW") {
+      WIN32_FIND_DATAW data{};
+      if (auto* find = exports_.find_first_(plugin, nullptr, path_ptr, &data, nullptr))
+        finds_[event.result_] = {event.plugin_, find};
+    } else if (event.name_ == "VFS_FindNextFileW") {
+      auto find = finds_.find(event.handle_);
+      if (find == finds_.end())
+        return std::nullopt;
+      WIN32_FIND_DATAW data{};
+      start = Clock::now();
+      exports_.find_next_(plugin, nullptr, find->second.second, &data);
+    } else if (event.name_ == "VFS_FindClose") {
+      auto find = finds_.find(event.handle_);
+      if (find == finds_.end())
+        return std::nullopt;
+      exports_.find_close_(plugin, find->second.second);
+      finds_.erase(find);
+    } else if (event.name_ == "VFS_ExtractFilesW") {
+      // Only extractions of a single file get here.
+      path.push_back(L'\0');
+      std::wstring destination = extract_to_.native();
+      VFSEXTRACTFILESDATAW data{};
+      data.cbSize = sizeof(data);
+      data.lpszFiles = path.data();
+      data.lpszDestPath = destination.data();
+      start = Clock::now();
+      exports_.extract_files_(plugin, nullptr, &data);
+    } else {
+      return std::nullopt;
+    }
+    return Microseconds(start);
+  }
+
+ private:
+  const Exports& exports_;
+  HANDLE heap_{};
+  // Recorded identifiers to live ones. Files and finds also keep the recorded plugin they belong to.
+  std::map<uint64_t, void*> plugins_;
+  std::map<uint64_t, std::pair<uint64_t, void*>> files_;
+  std::map<uint64_t, std::pair<uint64_t, void*>> finds_;
+};
+#endif
+
+/// @brief The plugin core, with the tree lookups that the VFS layer makes on top of it made accessible.
+class ReplayCore : public PluginCore {
+ public:
+  using PluginCore::FindEntry;
+
+  /// @brief Returns the root of the loaded archive's tree, which keeps the tree alive.
+  std::shared_ptr<DirEnt> Root() const { return mRoot; }
+};
+
+/// @brief Replays calls against the plugin core, on any platform, making the core calls that the plugin's VFS exports
+/// make for them.
+class CoreReplayer : public Replayer {
+ public:
+  CoreReplayer(std::vector<std::pair<std::string, std::string>> mappings, std::filesystem::path extract_to)
+      : Replayer(std::move(mappings), std::move(extract_to)) {}
+
+  ~CoreReplayer() override {
+    for (auto& [recorded, handle] : files_) {
+      if (plugins_.contains(handle.first))
+        plugins_[handle.first]->CloseFile(handle.second);
+    }
+  }
+
+  std::optional<double> Replay(const Event& event) override {
+    auto found = plugins_.find(event.plugin_);
+    ReplayCore* plugin = found != plugins_.end() ? found->second.get() : nullptr;
+    auto mapped = MapPath(event.path_);
+#ifndef _WIN32
+    std::ranges::replace(mapped, '\\', '/');
+#endif
+    auto path = utf8_to_path(mapped);
+
+    auto start = Clock::now();
+    if (event.name_ == "VFS_Create") {
+      plugins_[event.result_] = std::make_unique<ReplayCore>();
+      return Microseconds(start);
+    }
+    if (!plugin)
+      return std::nullopt;
+    if (event.name_ == "VFS_Destroy") {
+      plugins_.erase(found);
+      return Microseconds(start);
+    }
+
+    auto call = plugin->Enter();
+    if (event.name_ == "VFS_Clone") {
+      plugins_[event.result_] = std::make_unique<ReplayCore>(*plugin);
+    } else if (event.name_ == "VFS_ReadDirectoryW") {
+      // The plugin builds a file data header for every child.
+      if (auto* dir = plugin->FindEntry(ArchivePath(path))) {
+        for (const auto& [name, child] : dir->children_)
+          touched_ += name.size();
+      }
+    } else if (event.name_ == "VFS_CreateFileW") {
+      if (auto* file = plugin->OpenFile(ArchivePath(path), event.size_ == kGenericWrite))
+        files_[event.result_] = {event.plugin_, file};
+    } else if (event.name_ == "VFS_ReadFile") {
+      auto file = files_.find(event.handle_);
+      if (file == files_.end())
+        return std::nullopt;
+      buffer_.resize(event.size_);
+      size_t read{};
+      start = Clock::now();
+      plugin->ReadFile(file->second.second, buffer_, &read);
+    } else if (event.name_ == "VFS_CloseFile") {
+      auto file = files_.find(event.handle_);
+      if (file == files_.end())
+        return std::nullopt;
+      plugin->CloseFile(file->second.second);
+      files_.erase(file);
+    } else if (event.name_ == "VFS_GetFileAttrW" || event.name_ == "VFS_GetFileSizeW" ||
+               event.name_ == "VFS_GetFileInformationW") {
+      // Sizes of open files are answered from the handle, without a lookup.
+      if (!files_.contains(event.handle_))
+        plugin->FindEntry(ArchivePath(path));
+    } else if (event.name_ == "VFS_FindFirstFileW") {
+      ArchivePath pattern_path(path);
+      auto* dir = plugin->FindEntry(pattern_path.parent_path());
+      if (!dir)
+        return Microseconds(start);
+      Find find{plugin->Root(), dir->children_.begin(), dir->children_.end()};
+      char pattern[kMaxPattern];
+      find.pattern_.assign(pattern, native_to_utf8(pattern_path.filename(), pattern));
+      if (find.pattern_ == "*" || find.pattern_ == "*.*")
+        find.pattern_.clear();
+      if (Advance(find))
+        finds_[event.result_] = std::move(find);
+    } else if (event.name_ == "VFS_FindNextFileW") {
+      auto find = finds_.find(event.handle_);
+      if (find == finds_.end())
+        return std::nullopt;
+      start = Clock::now();
+      Advance(find->second);
+    } else if (event.name_ == "VFS_FindClose") {
+      if (!finds_.erase(event.handle_))
+        return std::nullopt;
+    } else if (event.name_ == "VFS_ExtractFilesW") {
+      // The plugin extracts each file into the destination under its own name, as ExtractTo names it.
+      FileSink sink(extract_to_);
+      start = Clock::now();
+      plugin->ExtractTo(path, sink);
+    } else {
+      return std::nullopt;
+    }
+    return Microseconds(start);
+  }
+
+ private:
+  // GENERIC_WRITE, the mode recorded for files opened for writing.
+  static constexpr uint64_t kGenericWrite = 0x40000000;
+  static constexpr size_t kMaxPattern = 260 * 3;
+
+  /// @brief Enumeration in progress. Matches names the way Plugin::FindNext does.
+  struct Find {
+    std::shared_ptr<PluginCore::DirEnt> root_;
+    decltype(PluginCore::DirEnt::children_)::const_iterator current_;
+    decltype(PluginCore::DirEnt::children_)::const_iterator end_;
+    std::string pattern_;
+  };
+
+  /// @brief Moves past the next child matching the pattern. Returns false once there is none.
+  static bool Advance(Find& find) {
+    while (find.current_ != find.end_) {
+      const auto& name = (find.current_++)->first;
+      if (find.pattern_.empty() || wildcard_match(find.pattern_, name))
+        return true;
+    }
+    return false;
+  }
+
+  // Recorded identifiers to live ones. Files also keep the recorded plugin they belong to.
+  std::map<uint64_t, std::unique_ptr<ReplayCore>> plugins_;
+  std::map<uint64_t, std::pair<uint64_t, PluginFile*>> files_;
+  std::map<uint64_t, Find> finds_;
+  // Keeps the directory walks from being optimized away.
+  size_t touched_{};
+};
+
+/// @brief Returns the nearest-rank percentile of sorted samples.
+double percentile(const std::vector<double>& sorted, double fraction) {
+  auto rank = static_cast<size_t>(fraction * sorted.size() + 0.5);
+  return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+}
+
+int usage(const char* program) {
+  std::fprintf(stderr,
+               "usage: %s (<plugin.dll> | --core) <trace.json> [--map FROM=TO]... [--extract-to DIR] [--repeat N]\n"
+               "       [--report FILE] [--baseline FILE] [--tolerance PERCENT]\n",
+               program);
+  return 2;
+}
+
+/// @brief Parses the whole of `text` as a number.
+template <typename T>
+std::optional<T> parse_number(std::string_view text) {
+  T value{};
+  auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+  if (error != std::errc() || end != text.data() + text.size())
+    return std::nullopt;
+  return value;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 3)
+    return usage(argv[0]);
+
+  std::vector<std::pair<std::string, std::string>> mappings;
+  std::error_code error;
+  std::filesystem::path extract_to = std::filesystem::temp_directory_path(error) / "opuslzx-replay";
+  std::filesystem::path report_path;
+  std::filesystem::path baseline_path;
+  double tolerance = 10;
+  int repeat = 1;
+  for (int arg = 3; arg < argc; ++arg) {
+    std::string_view option = argv[arg];
+    if (arg + 1 == argc) {
+      std::fprintf(stderr, "missing value for %s\n", argv[arg]);
+      return usage(argv[0]);
+    }
+    std::string_view value = argv[++arg];
+    if (option == "--map" && value.find('=') != std::string_view::npos) {
+      mappings.emplace_back(value.substr(0, value.find('=')), value.substr(value.find('=') + 1));
+    } else if (option == "--extract-to") {
+      extract_to = value;
+    } else if (option == "--repeat") {
+      auto parsed = parse_number<int>(value);
+      if (!parsed || *parsed < 1) {
+        std::fprintf(stderr, "invalid --repeat value %s\n", argv[arg]);
+        return usage(argv[0]);
+      }
+      repeat = *parsed;
+    } else if (option == "--report") {
+      report_path = value;
+    } else if (option == "--baseline") {
+      baseline_path = value;
+    } else if (option == "--tolerance") {
+      auto parsed = parse_number<double>(value);
+      if (!parsed || !(*parsed >= 0)) {
+        std::fprintf(stderr, "invalid --tolerance value %s\n", argv[arg]);
+        return usage(argv[0]);
+      }
+      tolerance = *parsed;
+    } else {
+      std::fprintf(stderr, "invalid option %s %s\n", argv[arg - 1], argv[arg]);
+      return usage(argv[0]);
+    }
+  }
+
+  bool core = std::string_view(argv[1]) == "--core";
+#ifdef _WIN32
+  HMODULE module{};
+  std::optional<Exports> exports;
+  if (!core) {
+    module = LoadLibraryA(argv[1]);
+    if (!module) {
+      std::fprintf(stderr, "cannot load %s\n", argv[1]);
+      return 2;
+    }
+    exports = load_exports(module);
+    if (!exports)
+      return 2;
+  }
+#else
+  if (!core) {
+    std::fprintf(stderr, "replaying against the plugin DLL needs Windows; use --core\n");
+    return usage(argv[0]);
+  }
+#endif
+
+  auto events = read_trace(argv[2]);
+  if (events.empty()) {
+    std::fprintf(stderr, "no events in %s\n", argv[2]);
+    return 2;
+  }
+  std::filesystem::create_directories(extract_to, error);
+
+  std::map<std::string, std::vector<double>> samples;
+  size_t skipped = 0;
+  size_t truncated = 0;
+  size_t multiple = 0;
+  auto wall_start = std::chrono::steady_clock::now();
+  for (int round = 0; round < repeat; ++round) {
+    std::unique_ptr<Replayer> replayer;
+#ifdef _WIN32
+    if (!core)
+      replayer = std::make_unique<DllReplayer>(*exports, mappings, extract_to);
+#endif
+    if (!replayer)
+      replayer = std::make_unique<CoreReplayer>(mappings, extract_to);
+    for (const auto& event : events) {
+      if (event.truncated_) {
+        ++truncated;
+        continue;
+      }
+      if (event.name_ == "VFS_ExtractFilesW" && event.size_ > 1) {
+        ++multiple;
+        continue;
+      }
+      if (auto duration = replayer->Replay(event))
+        samples[event.name_].push_back(*duration);
+      else
+        ++skipped;
+    }
+  }
+  auto wall_time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - wall_start).count();
+
+  std::map<std::string, Stats> report;
+  std::printf("%-26s %8s %10s %10s %10s %10s\n", "call", "count", "p50 us", "p90 us", "p99 us", "max us");
+  for (auto& [name, durations] : samples) {
+    std::ranges::sort(durations);
+    Stats stats{durations.size(), percentile(durations, 0.5), percentile(durations, 0.9),
+                percentile(durations, 0.99), durations.back()};
+    std::printf("%-26s %8zu %10.1f %10.1f %10.1f %10.1f\n", name.c_str(), stats.count_, stats.p50_, stats.p90_,
+                stats.p99_, stats.max_);
+    report.emplace(name, stats);
+  }
+  std::printf("\n%zu calls replayed, %zu skipped, wall time %.1f ms\n",
+              events.size() * repeat - skipped - truncated - multiple, skipped, wall_time);
+  if (truncated)
+    std::printf("%zu calls with a truncated path not replayed\n", truncated);
+  if (multiple)
+    std::printf("%zu extractions of several files not replayed\n", multiple);
+
+  if (!report_path.empty()) {
+    std::ofstream stream(report_path);
+    for (const auto& [name, stats] : report)
+      stream << name << '\t' << stats.count_ << '\t' << stats.p50_ << '\t' << stats.p90_ << '\t' << stats.p99_ << '\t'
+             << stats.max_ << '\n';
+  }
+
+  int result = 0;
+  if (!baseline_path.empty()) {
+    for (const auto& [name, baseline] : read_report(baseline_path)) {
+      auto current = report.find(name);
+      if (current == report.end())
+        continue;
+      if (current->second.p99_ > baseline.p99_ * (1 + tolerance / 100)) {
+        std::printf("REGRESSION %s: p99 %.1f us against baseline %.1f us\n", name.c_str(), current->second.p99_,
+                    baseline.p99_);
+        result = 1;
+      }
+    }
+  }
+
+#ifdef _WIN32
+  if (module)
+    FreeLibrary(module);
+#endif
+  return result;
+}